@@ -0,0 +1,234 @@
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+
+#include "../include/aitoolkit/behtree.hpp"
+
+using namespace aitoolkit::bt;
+
+namespace {
+  struct blackboard_type {
+    float health{100.0f};
+    float distance{10.0f};
+    int ammo{8};
+    int counter{0};
+  };
+
+  using tree_factory = std::function<node_ptr<blackboard_type>()>;
+
+  constexpr std::size_t agent_counts[] = {1, 100, 10'000, 100'000};
+  constexpr std::size_t deep_depth = 8;
+  constexpr std::size_t wide_width = 16;
+
+  auto succeed = [](blackboard_type& bb) {
+    bb.counter++;
+    return execution_state::success;
+  };
+
+  auto always_true = [](const blackboard_type& bb) {
+    return bb.health > 0.0f;
+  };
+
+  auto always_false = [](const blackboard_type& bb) {
+    return bb.health < 0.0f;
+  };
+
+  node_ptr<blackboard_type> make_task() {
+    return std::make_unique<task<blackboard_type>>(succeed);
+  }
+
+  node_ptr<blackboard_type> make_check() {
+    return std::make_unique<check<blackboard_type>>(always_true);
+  }
+
+  node_ptr<blackboard_type> make_neg() {
+    return std::make_unique<neg<blackboard_type>>(
+      check<blackboard_type>(always_false)
+    );
+  }
+
+  node_ptr<blackboard_type> make_seq() {
+    auto children = std::vector<node_ptr<blackboard_type>>{};
+    for (std::size_t i = 0; i < 8; i++) {
+      children.push_back(make_task());
+    }
+
+    return std::make_unique<seq<blackboard_type>>(std::move(children));
+  }
+
+  node_ptr<blackboard_type> make_sel() {
+    auto children = std::vector<node_ptr<blackboard_type>>{};
+    for (std::size_t i = 0; i < 7; i++) {
+      children.push_back(std::make_unique<check<blackboard_type>>(always_false));
+    }
+    children.push_back(make_task());
+
+    return std::make_unique<sel<blackboard_type>>(std::move(children));
+  }
+
+  // seq(check, seq(check, seq(..., task)))
+  node_ptr<blackboard_type> make_deep(std::size_t depth = deep_depth) {
+    if (depth == 0) {
+      return make_task();
+    }
+
+    auto children = std::vector<node_ptr<blackboard_type>>{};
+    children.push_back(make_check());
+    children.push_back(make_deep(depth - 1));
+
+    return std::make_unique<seq<blackboard_type>>(std::move(children));
+  }
+
+  // sel(check, check, ..., task) where every check fails
+  node_ptr<blackboard_type> make_wide() {
+    auto children = std::vector<node_ptr<blackboard_type>>{};
+    for (std::size_t i = 0; i < wide_width; i++) {
+      children.push_back(std::make_unique<check<blackboard_type>>(always_false));
+    }
+    children.push_back(make_task());
+
+    return std::make_unique<sel<blackboard_type>>(std::move(children));
+  }
+
+  // Typical combat tree: attack, then chase, then flee, then patrol.
+  node_ptr<blackboard_type> make_mixed() {
+    return std::make_unique<sel<blackboard_type>>(
+      node_list<blackboard_type>(
+        seq<blackboard_type>(
+          node_list<blackboard_type>(
+            check<blackboard_type>([](const blackboard_type& bb) {
+              return bb.distance < 2.0f;
+            }),
+            check<blackboard_type>([](const blackboard_type& bb) {
+              return bb.ammo > 0;
+            }),
+            task<blackboard_type>(succeed)
+          )
+        ),
+        seq<blackboard_type>(
+          node_list<blackboard_type>(
+            check<blackboard_type>([](const blackboard_type& bb) {
+              return bb.distance < 5.0f;
+            }),
+            neg<blackboard_type>(
+              check<blackboard_type>([](const blackboard_type& bb) {
+                return bb.health < 25.0f;
+              })
+            ),
+            task<blackboard_type>(succeed)
+          )
+        ),
+        seq<blackboard_type>(
+          node_list<blackboard_type>(
+            check<blackboard_type>([](const blackboard_type& bb) {
+              return bb.health < 25.0f;
+            }),
+            task<blackboard_type>(succeed)
+          )
+        ),
+        seq<blackboard_type>(
+          node_list<blackboard_type>(
+            task<blackboard_type>(succeed),
+            task<blackboard_type>(succeed)
+          )
+        )
+      )
+    );
+  }
+
+  void run_shape(const char* shape, tree_factory factory) {
+    for (auto agents : agent_counts) {
+      auto trees = std::vector<node_ptr<blackboard_type>>{};
+      auto blackboards = std::vector<blackboard_type>(agents);
+
+      trees.reserve(agents);
+      for (std::size_t i = 0; i < agents; i++) {
+        trees.push_back(factory());
+      }
+
+      auto footprint = total_footprint<blackboard_type>(trees);
+
+      for (auto cache : {bench::cache_mode::warm, bench::cache_mode::cold}) {
+        auto rec = bench::measure(agents, cache, [&](std::size_t first, std::size_t last) {
+          for (std::size_t i = first; i < last; i++) {
+            auto state = trees[i]->evaluate(blackboards[i]);
+            bench::do_not_optimize(state);
+          }
+        });
+
+        bench::report(
+          bench::record{}
+            .set("suite", "behtree")
+            .set("shape", shape)
+            .set("agents", agents)
+            .set("nodes_per_tree", footprint.node_count / agents)
+            .set("bytes_per_tree", footprint.total() / agents)
+            .merge(rec)
+        );
+      }
+    }
+  }
+}
+
+BENCH_CASE("behtree task") {
+  run_shape("task", make_task);
+}
+
+BENCH_CASE("behtree check") {
+  run_shape("check", make_check);
+}
+
+BENCH_CASE("behtree neg") {
+  run_shape("neg", make_neg);
+}
+
+BENCH_CASE("behtree seq") {
+  run_shape("seq", make_seq);
+}
+
+BENCH_CASE("behtree sel") {
+  run_shape("sel", make_sel);
+}
+
+BENCH_CASE("behtree deep") {
+  run_shape("deep", []() { return make_deep(); });
+}
+
+BENCH_CASE("behtree wide") {
+  run_shape("wide", make_wide);
+}
+
+BENCH_CASE("behtree mixed") {
+  run_shape("mixed", make_mixed);
+}
+
+BENCH_CASE("behtree spawn") {
+  constexpr std::size_t agents = 5'000;
+
+  auto prototype = make_mixed();
+  auto trees = std::vector<node_ptr<blackboard_type>>(agents);
+
+  auto report = [&](const char* method, bench::record rec) {
+    bench::report(
+      bench::record{}
+        .set("suite", "behtree")
+        .set("shape", "mixed")
+        .set("method", method)
+        .set("agents", agents)
+        .merge(rec)
+    );
+  };
+
+  report("build", bench::measure(agents, bench::cache_mode::warm, [&](std::size_t first, std::size_t last) {
+    for (auto i = first; i < last; i++) {
+      trees[i] = make_mixed();
+    }
+  }));
+
+  report("clone", bench::measure(agents, bench::cache_mode::warm, [&](std::size_t first, std::size_t last) {
+    clone_n(*prototype, last - first, trees.begin() + first);
+  }));
+}
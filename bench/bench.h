@@ -0,0 +1,290 @@
+#pragma once
+
+/*
+ * Minimal benchmark harness.
+ *
+ * Benchmarks are registered with BENCH_CASE() and every measurement is
+ * reported on stdout as one JSON object per line, so that results can be
+ * diffed between releases by any tool.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bench {
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * State of the CPU caches when a measurement starts.
+   *
+   * A warm measurement repeats the workload back to back, a cold measurement
+   * evicts the caches before every run.
+   */
+  enum class cache_mode {
+    warm,
+    cold
+  };
+
+  inline const char* to_string(cache_mode mode) {
+    return mode == cache_mode::warm ? "warm" : "cold";
+  }
+
+  /**
+   * Number of calls to the global `operator new` since the start of the
+   * program (defined in main.cpp).
+   */
+  std::uint64_t allocation_count();
+
+  /**
+   * Prevent the compiler from optimizing away a computed value.
+   */
+  template <typename V>
+  inline void do_not_optimize(V const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile auto sink = value;
+    sink = value;
+#endif
+  }
+
+  /**
+   * Evict the data caches by walking a buffer larger than the last level
+   * cache.
+   */
+  inline void flush_caches() {
+    static auto buffer = std::vector<unsigned char>(64 * 1024 * 1024);
+    static unsigned char counter = 0;
+
+    counter++;
+    for (std::size_t i = 0; i < buffer.size(); i += 64) {
+      buffer[i] += counter;
+    }
+
+    do_not_optimize(buffer.data());
+  }
+
+  /**
+   * One line of the report: an ordered list of JSON fields.
+   */
+  class record {
+    public:
+      record& set(std::string_view key, std::string_view value) {
+        auto encoded = std::string{"\""};
+        for (auto c : value) {
+          if (c == '"' || c == '\\') {
+            encoded += '\\';
+          }
+          encoded += c;
+        }
+        encoded += '"';
+
+        m_fields.emplace_back(std::string{key}, std::move(encoded));
+        return *this;
+      }
+
+      record& set(std::string_view key, const char* value) {
+        return set(key, std::string_view{value});
+      }
+
+      template <typename N>
+      requires std::is_arithmetic_v<N>
+      record& set(std::string_view key, N value) {
+        if constexpr (std::is_floating_point_v<N>) {
+          char buffer[64];
+          std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(value));
+          m_fields.emplace_back(std::string{key}, buffer);
+        }
+        else {
+          m_fields.emplace_back(std::string{key}, std::to_string(value));
+        }
+
+        return *this;
+      }
+
+      record& merge(const record& other) {
+        m_fields.insert(m_fields.end(), other.m_fields.begin(), other.m_fields.end());
+        return *this;
+      }
+
+      std::string to_json() const {
+        auto json = std::string{"{"};
+
+        for (std::size_t i = 0; i < m_fields.size(); i++) {
+          if (i > 0) {
+            json += ", ";
+          }
+
+          json += "\"" + m_fields[i].first + "\": " + m_fields[i].second;
+        }
+
+        json += "}";
+        return json;
+      }
+
+    private:
+      std::vector<std::pair<std::string, std::string>> m_fields;
+  };
+
+  /**
+   * Print a record on stdout.
+   */
+  inline void report(const record& rec) {
+    std::printf("%s\n", rec.to_json().c_str());
+    std::fflush(stdout);
+  }
+
+  /**
+   * Run `fn` at least `min_runs` times and for at least `min_time`, then compute
+   * the throughput, and the latency distribution of the operations.
+   *
+   * A run performs `ops_per_run` operations, `fn(first, last)` performs the
+   * operations `[first, last)` of the current run. The throughput is measured
+   * on whole runs. The latency is measured on chunks of `chunk_ops`
+   * operations, so that reading the clock does not dominate it: the
+   * percentiles are computed over the average cost of an operation in each
+   * chunk.
+   */
+  template <typename F>
+  record measure(
+    std::size_t ops_per_run,
+    cache_mode cache,
+    F&& fn,
+    std::size_t chunk_ops = 16,
+    std::size_t min_runs = 5,
+    clock::duration min_time = std::chrono::milliseconds(100)
+  ) {
+    constexpr std::size_t min_latency_samples = 200;
+    constexpr std::size_t max_latency_samples = 100'000;
+
+    chunk_ops = std::clamp<std::size_t>(chunk_ops, 1, ops_per_run);
+
+    // Warm runs are batched so that a sample is long enough to hide the cost
+    // of reading the clock.
+    auto batch = std::size_t{1};
+
+    if (cache == cache_mode::warm) {
+      while (true) {
+        auto start = clock::now();
+        for (std::size_t i = 0; i < batch; i++) {
+          fn(std::size_t{0}, ops_per_run);
+        }
+
+        if (clock::now() - start >= std::chrono::microseconds(20)) {
+          break;
+        }
+
+        batch *= 2;
+      }
+    }
+
+    auto runs = std::size_t{0};
+    auto elapsed = clock::duration::zero();
+    auto allocations = std::uint64_t{0};
+    auto wall_start = clock::now();
+
+    // Cache flushes are not measured but still count towards the time budget,
+    // otherwise a cold run of a tiny workload would flush forever.
+    while (runs < min_runs || clock::now() - wall_start < min_time) {
+      if (cache == cache_mode::cold) {
+        flush_caches();
+      }
+
+      auto allocations_before = allocation_count();
+      auto start = clock::now();
+      for (std::size_t i = 0; i < batch; i++) {
+        fn(std::size_t{0}, ops_per_run);
+      }
+      auto duration = clock::now() - start;
+
+      allocations += allocation_count() - allocations_before;
+      elapsed += duration;
+      runs += batch;
+    }
+
+    // Every run is completed, so that the workload stays in a known state.
+    auto latencies = std::vector<double>{};
+    wall_start = clock::now();
+
+    while (
+      latencies.size() < max_latency_samples &&
+      (latencies.size() < min_latency_samples || clock::now() - wall_start < min_time)
+    ) {
+      if (cache == cache_mode::cold) {
+        flush_caches();
+      }
+
+      for (std::size_t first = 0; first < ops_per_run; first += chunk_ops) {
+        auto last = std::min(first + chunk_ops, ops_per_run);
+
+        auto start = clock::now();
+        fn(first, last);
+        auto duration = clock::now() - start;
+
+        latencies.push_back(
+          std::chrono::duration<double, std::nano>(duration).count() /
+          static_cast<double>(last - first)
+        );
+      }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&](double p) {
+      auto idx = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1));
+      return latencies[idx];
+    };
+
+    auto total_ops = static_cast<double>(ops_per_run * runs);
+    auto total_ns = std::chrono::duration<double, std::nano>(elapsed).count();
+
+    return record{}
+      .set("cache", to_string(cache))
+      .set("runs", runs)
+      .set("ops_per_run", ops_per_run)
+      .set("ns_per_op", total_ns / total_ops)
+      .set("ops_per_sec", total_ops * 1e9 / total_ns)
+      .set("latency_chunk_ops", chunk_ops)
+      .set("latency_samples", latencies.size())
+      .set("p50_ns_per_op", percentile(0.50))
+      .set("p99_ns_per_op", percentile(0.99))
+      .set("allocs_per_op", static_cast<double>(allocations) / total_ops);
+  }
+
+  struct case_entry {
+    const char* name;
+    void (*fn)();
+  };
+
+  inline std::vector<case_entry>& registry() {
+    static auto cases = std::vector<case_entry>{};
+    return cases;
+  }
+
+  struct registrar {
+    registrar(const char* name, void (*fn)()) {
+      registry().push_back(case_entry{name, fn});
+    }
+  };
+}
+
+#define BENCH_CONCAT_IMPL(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_IMPL(a, b)
+
+#define BENCH_CASE_IMPL(fn_name, name) \
+  static void fn_name(); \
+  static bench::registrar BENCH_CONCAT(fn_name, _registrar){name, &fn_name}; \
+  static void fn_name()
+
+/**
+ * Register a benchmark case, the case body reports its own records.
+ */
+#define BENCH_CASE(name) BENCH_CASE_IMPL(BENCH_CONCAT(bench_case_, __LINE__), name)
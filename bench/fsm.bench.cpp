@@ -0,0 +1,319 @@
+#include <cstddef>
+#include <vector>
+
+#include "bench.h"
+
+#include "../include/aitoolkit/fsm.hpp"
+
+using namespace aitoolkit::fsm;
+
+namespace {
+  struct blackboard_type {
+    int counter{0};
+  };
+
+  class state_idle final : public state<blackboard_type> {
+    public:
+      virtual void update(blackboard_type& bb) override {
+        bb.counter++;
+      }
+  };
+
+  class state_busy final : public state<blackboard_type> {
+    public:
+      virtual void update(blackboard_type& bb) override {
+        bb.counter += 2;
+      }
+  };
+
+  constexpr std::size_t machine_counts[] = {1, 100, 10'000, 1'000'000};
+
+  // A fleet holds `count` machines of one kind, all starting in state_idle.
+  // `update(first, last)` updates the machines `[first, last)` once, and
+  // `transition(frame, first, last)` moves them to state_busy on odd frames
+  // and back to state_idle on even ones. A fleet whose machines can only be
+  // updated all at once has `chunk_ops()` equal to its size.
+
+  struct simple_fleet {
+    static constexpr const char* name = "simple_machine";
+
+    std::vector<simple_machine<blackboard_type>> machines;
+    std::vector<blackboard_type> blackboards;
+
+    explicit simple_fleet(std::size_t count) : machines(count), blackboards(count) {
+      for (std::size_t i = 0; i < count; i++) {
+        machines[i].set_state(state_idle{}, blackboards[i]);
+      }
+    }
+
+    std::size_t chunk_ops() const {
+      return 16;
+    }
+
+    void update(std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        machines[i].update(blackboards[i]);
+      }
+    }
+
+    void transition(std::size_t frame, std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        if (frame & 1) {
+          machines[i].set_state(state_busy{}, blackboards[i]);
+        }
+        else {
+          machines[i].set_state(state_idle{}, blackboards[i]);
+        }
+      }
+    }
+  };
+
+  template <std::size_t N>
+  struct stack_fleet {
+    static constexpr const char* name = N == 0 ? "stack_machine" : "stack_machine<4>";
+
+    std::vector<stack_machine<blackboard_type, N>> machines;
+    std::vector<blackboard_type> blackboards;
+
+    explicit stack_fleet(std::size_t count) : machines(count), blackboards(count) {
+      for (std::size_t i = 0; i < count; i++) {
+        machines[i].push_state(state_idle{}, blackboards[i]);
+      }
+    }
+
+    std::size_t chunk_ops() const {
+      return 16;
+    }
+
+    void update(std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        machines[i].update(blackboards[i]);
+      }
+    }
+
+    // Interrupt on odd frames, back to the interrupted state on even ones.
+    void transition(std::size_t frame, std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        if (frame & 1) {
+          machines[i].push_state(state_busy{}, blackboards[i]);
+        }
+        else {
+          machines[i].pop_state(blackboards[i]);
+        }
+      }
+    }
+  };
+
+  struct static_fleet {
+    static constexpr const char* name = "static_machine";
+
+    std::vector<static_machine<blackboard_type, state_idle, state_busy>> machines;
+    std::vector<blackboard_type> blackboards;
+
+    explicit static_fleet(std::size_t count) : machines(count), blackboards(count) {
+      for (std::size_t i = 0; i < count; i++) {
+        machines[i].set_state(state_idle{}, blackboards[i]);
+      }
+    }
+
+    std::size_t chunk_ops() const {
+      return 16;
+    }
+
+    void update(std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        machines[i].update(blackboards[i]);
+      }
+    }
+
+    void transition(std::size_t frame, std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        if (frame & 1) {
+          machines[i].set_state(state_busy{}, blackboards[i]);
+        }
+        else {
+          machines[i].set_state(state_idle{}, blackboards[i]);
+        }
+      }
+    }
+  };
+
+  struct flyweight_fleet {
+    static constexpr const char* name = "flyweight_machine";
+
+    std::vector<flyweight_machine<blackboard_type>> machines;
+    std::vector<blackboard_type> blackboards;
+
+    explicit flyweight_fleet(std::size_t count) : machines(count), blackboards(count) {
+      for (std::size_t i = 0; i < count; i++) {
+        machines[i].set_state<state_idle>(blackboards[i]);
+      }
+    }
+
+    std::size_t chunk_ops() const {
+      return 16;
+    }
+
+    void update(std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        machines[i].update(blackboards[i]);
+      }
+    }
+
+    void transition(std::size_t frame, std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++) {
+        if (frame & 1) {
+          machines[i].set_state<state_busy>(blackboards[i]);
+        }
+        else {
+          machines[i].set_state<state_idle>(blackboards[i]);
+        }
+      }
+    }
+  };
+
+  struct pool_fleet {
+    static constexpr const char* name = "machine_pool";
+
+    machine_pool<blackboard_type, state_idle, state_busy> pool;
+
+    explicit pool_fleet(std::size_t count) {
+      for (std::size_t i = 0; i < count; i++) {
+        auto id = pool.add_machine(blackboard_type{});
+        pool.set_state(id, state_idle{});
+      }
+    }
+
+    // The pool updates all its machines at once.
+    std::size_t chunk_ops() const {
+      return pool.size();
+    }
+
+    void update(std::size_t, std::size_t) {
+      pool.update();
+    }
+
+    void transition(std::size_t frame, std::size_t first, std::size_t last) {
+      for (machine_id id = first; id < last; id++) {
+        if (frame & 1) {
+          pool.set_state(id, state_busy{});
+        }
+        else {
+          pool.set_state(id, state_idle{});
+        }
+      }
+    }
+  };
+
+  bench::record fsm_record(const char* machine, const char* scenario, std::size_t count) {
+    return bench::record{}
+      .set("suite", "fsm")
+      .set("machine", machine)
+      .set("scenario", scenario)
+      .set("machines", count);
+  }
+
+  // steady: every machine is updated, without any transition.
+  // storm: every machine transitions, then is updated, at every frame.
+  template <typename Fleet>
+  void run_update() {
+    for (auto count : machine_counts) {
+      auto fleet = Fleet(count);
+      auto frame = std::size_t{0};
+
+      for (auto cache : {bench::cache_mode::warm, bench::cache_mode::cold}) {
+        bench::report(
+          fsm_record(Fleet::name, "steady", count)
+            .merge(bench::measure(count, cache, [&](std::size_t first, std::size_t last) {
+              fleet.update(first, last);
+            }, fleet.chunk_ops()))
+        );
+
+        bench::report(
+          fsm_record(Fleet::name, "storm", count)
+            .merge(bench::measure(count, cache, [&](std::size_t first, std::size_t last) {
+              if (first == 0) {
+                frame++;
+              }
+
+              fleet.transition(frame, first, last);
+              fleet.update(first, last);
+            }, fleet.chunk_ops()))
+        );
+
+        // Leave every machine in its initial state for the next measurement.
+        if (frame & 1) {
+          fleet.transition(++frame, 0, count);
+        }
+      }
+    }
+  }
+}
+
+BENCH_CASE("fsm set_state") {
+  for (auto count : machine_counts) {
+    auto fleet = simple_fleet(count);
+    auto frame = std::size_t{0};
+
+    for (auto cache : {bench::cache_mode::warm, bench::cache_mode::cold}) {
+      bench::report(
+        fsm_record(simple_fleet::name, "set_state", count)
+          .merge(bench::measure(count, cache, [&](std::size_t first, std::size_t last) {
+            if (first == 0) {
+              frame++;
+            }
+
+            fleet.transition(frame, first, last);
+          }))
+      );
+    }
+  }
+}
+
+BENCH_CASE("fsm push_pop") {
+  auto run = [&]<std::size_t N>() {
+    for (auto count : machine_counts) {
+      auto fleet = stack_fleet<N>(count);
+      auto frame = std::size_t{0};
+
+      for (auto cache : {bench::cache_mode::warm, bench::cache_mode::cold}) {
+        // One operation is a push followed by a pop.
+        bench::report(
+          fsm_record(stack_fleet<N>::name, "push_pop", count)
+            .merge(bench::measure(count, cache, [&](std::size_t first, std::size_t last) {
+              if (first == 0) {
+                frame += 2;
+              }
+
+              fleet.transition(frame - 1, first, last);
+              fleet.transition(frame, first, last);
+            }))
+        );
+      }
+    }
+  };
+
+  run.template operator()<0>();
+  run.template operator()<4>();
+}
+
+BENCH_CASE("fsm update simple_machine") {
+  run_update<simple_fleet>();
+}
+
+BENCH_CASE("fsm update stack_machine") {
+  run_update<stack_fleet<0>>();
+  run_update<stack_fleet<4>>();
+}
+
+BENCH_CASE("fsm update static_machine") {
+  run_update<static_fleet>();
+}
+
+BENCH_CASE("fsm update flyweight_machine") {
+  run_update<flyweight_fleet>();
+}
+
+BENCH_CASE("fsm update machine_pool") {
+  run_update<pool_fleet>();
+}
@@ -0,0 +1,51 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+#include "bench.h"
+
+namespace {
+  std::atomic<std::uint64_t> allocations{0};
+}
+
+std::uint64_t bench::allocation_count() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+// Count the allocations of the benchmarked code, the other forms of
+// operator new and delete forward to these.
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (auto ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+int main(int argc, char** argv) {
+  auto filter = std::string_view{argc > 1 ? argv[1] : ""};
+
+  for (auto& entry : bench::registry()) {
+    if (std::string_view{entry.name}.find(filter) == std::string_view::npos) {
+      continue;
+    }
+
+    std::fprintf(stderr, "  BENCH   %s\n", entry.name);
+    entry.fn();
+  }
+
+  return 0;
+}
@@ -128,13 +128,144 @@ while (true) {
   }
 }
 ```
+
+## Utility selector
+
+A `utility_sel` node runs its children by descending score, like a selector
+ordered by the utility of each branch. The scores are cached, and only
+recomputed every N evaluations or when the inputs changed:
+
+```cpp
+auto tree = utility_sel<blackboard_type>(
+  node_list<blackboard_type>(
+    task<blackboard_type>([](blackboard_type& bb) {
+      // Attack
+      return execution_state::success;
+    }),
+    task<blackboard_type>([](blackboard_type& bb) {
+      // Flee
+      return execution_state::success;
+    })
+  ),
+  {
+    [](const blackboard_type& bb) { return bb.attack_range - distance(bb); },
+    [](const blackboard_type& bb) { return distance(bb) - bb.sight_range; }
+  },
+  10, // recompute the scores every 10 evaluations...
+  [](const blackboard_type& bb) {
+    // ...or when this value changes
+    return bb.enemy_moved_count;
+  }
+);
+```
+
+> **NB:** The cache is per-agent state stored in the node itself, and is
+> updated by `evaluate()`. A tree containing a `utility_sel` must not be
+> shared between agents, nor evaluated by several threads at once: give each
+> agent its own tree, with `clone()` (see below).
+
+## Reactive selector
+
+A plain `sel` node is reactive because it evaluates all its children from
+the first one on every evaluation. In large trees, this means re-walking the
+higher priority branches on every tick.
+
+A `reactive_sel` node instead watches the conditions of its `guard` children.
+While a child is running, only the conditions up to the running child are
+evaluated, and the running child is resumed directly. It is interrupted
+(with `halt()`) only when one of those conditions flips:
+
+```cpp
+auto tree = reactive_sel<blackboard_type>(
+  node_list<blackboard_type>(
+    guard<blackboard_type>(
+      check<blackboard_type>([](const blackboard_type& bb) {
+        auto distance = glm::distance(bb.agent_position, bb.enemy_position);
+        return distance <= bb.attack_range;
+      }),
+      task<blackboard_type>([](blackboard_type& bb) {
+        // Destroy enemy
+        return execution_state::running;
+      })
+    ),
+    task<blackboard_type>([](blackboard_type& bb) {
+      // Move towards waypoint
+      return execution_state::running;
+    })
+  )
+);
+```
+
+> **NB:**
+>
+>  - the running child and the guard results are per-agent state stored in
+>    the node: a tree containing a `reactive_sel` must not be shared between
+>    agents, nor evaluated by several threads at once
+>  - a `sel`, `seq` or `guard` node above a `reactive_sel` or a `utility_sel`
+>    also remembers its running child, and halts it when a later evaluation
+>    does not reach it anymore, so that the nested node does not resume an
+>    abandoned child
+>  - trees without `reactive_sel` nor `utility_sel` nodes keep no per-agent
+>    state, and can still be shared between agents and threads
+>    (`has_agent_state()` tells which trees can be shared)
+
+## Cloning
+
+Instead of building the tree of every agent again, a prototype can be cloned:
+
+```cpp
+auto prototype = sel<blackboard_type>(...);
+
+auto agent_tree = prototype.clone();
+
+// or many at once, into preallocated slots:
+auto trees = std::vector<node_ptr<blackboard_type>>(5000);
+clone_n(prototype, trees.size(), trees.begin());
+```
+
+> **NB:** Custom nodes must implement `clone()`, and may return `nullptr` if
+> they cannot be cloned, in which case `clone_n` writes nothing.
+
+## Memory footprint
+
+The memory used by a tree can be inspected with `footprint()`:
+
+```cpp
+auto fp = tree.footprint();
+fp.node_count;      // number of nodes
+fp.nodes;           // size of the node objects
+fp.children;        // used part of the child vectors
+fp.unused_capacity; // reserved but unused part of the vectors held by nodes
+fp.callbacks;       // heap storage of the callbacks, and of the vectors holding them
+fp.agent_state;     // heap storage of the per-agent state held by nodes
+fp.total();
+```
+
+To budget a whole agent archetype, aggregate the footprints of many trees:
+
+```cpp
+std::vector<node_ptr<blackboard_type>> trees = ...;
+auto fp = total_footprint<blackboard_type>(trees);
+```
+
+> **NB:** The heap storage of a callback can only be detected when a `check`
+> or `task` node was constructed from a callable of the same type (not from a
+> `std::function`), and when the standard library is libstdc++, libc++ or the
+> MSVC STL.
 */
 
 #include <functional>
+#include <algorithm>
+#include <cassert>
 #include <memory>
+#include <utility>
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 
 #include <type_traits>
+#include <typeindex>
 #include <concepts>
 
 namespace aitoolkit::bt {
@@ -149,6 +280,135 @@ namespace aitoolkit::bt {
     running  /**< The node is still running */
   };
 
+  /**
+   * @ingroup behtree
+   * @struct memory_footprint
+   * @brief Memory used by one or more trees, in bytes
+   *
+   * Footprints can be summed with `+=` to aggregate the cost of many trees,
+   * for example all the trees of an agent archetype.
+   */
+  struct memory_footprint {
+    std::size_t node_count{0};      /**< Number of nodes */
+    std::size_t nodes{0};           /**< Size of the node objects */
+    std::size_t children{0};        /**< Used part of the child vectors */
+    std::size_t unused_capacity{0}; /**< Reserved but unused part of the vectors held by nodes */
+    std::size_t callbacks{0};       /**< Heap storage of the callbacks where it can be detected, and of the vectors holding them */
+    std::size_t agent_state{0};     /**< Heap storage of the per-agent state held by nodes */
+
+    /**
+     * @brief Total number of bytes
+     */
+    std::size_t total() const {
+      return nodes + children + unused_capacity + callbacks + agent_state;
+    }
+
+    memory_footprint& operator+=(const memory_footprint& other) {
+      node_count += other.node_count;
+      nodes += other.nodes;
+      children += other.children;
+      unused_capacity += other.unused_capacity;
+      callbacks += other.callbacks;
+      agent_state += other.agent_state;
+      return *this;
+    }
+  };
+
+  namespace detail {
+    template <typename Fn>
+    struct is_function_wrapper : std::false_type {};
+
+    template <typename Sig>
+    struct is_function_wrapper<std::function<Sig>> : std::true_type {};
+
+    /**
+     * Number of bytes a `std::function` allocates on the heap to store a
+     * callable of type `F`. The small buffer rules of the known standard
+     * libraries are mirrored here; when they are unknown, or when `F` is
+     * itself a `std::function`, the storage cannot be detected and 0 is
+     * returned.
+     */
+    template <typename F>
+    consteval std::size_t function_heap_size() {
+      if constexpr (is_function_wrapper<F>::value) {
+        return 0;
+      }
+      else {
+#if defined(__GLIBCXX__)
+        constexpr auto buffer_size = 2 * sizeof(void*);
+        constexpr auto local = (
+          std::is_trivially_copyable_v<F> &&
+          sizeof(F) <= buffer_size &&
+          alignof(F) <= alignof(void*) &&
+          buffer_size % alignof(F) == 0
+        );
+#elif defined(_LIBCPP_VERSION)
+        constexpr auto local = (
+          sizeof(F) <= 3 * sizeof(void*) &&
+          alignof(F) <= alignof(void*) &&
+          std::is_nothrow_copy_constructible_v<F>
+        );
+#elif defined(_MSC_VER)
+        constexpr auto local = (
+          sizeof(F) <= (5 + 16 / sizeof(void*)) * sizeof(void*) &&
+          alignof(F) <= alignof(std::max_align_t) &&
+          std::is_nothrow_move_constructible_v<F>
+        );
+#else
+        constexpr auto local = true;
+#endif
+
+        return local ? 0 : sizeof(F);
+      }
+    }
+
+    /**
+     * Heap storage of the callables for which `function_heap_size` is not 0,
+     * by type, so that the nodes do not need to store it.
+     */
+    struct callback_registry {
+      std::mutex mutex;
+      std::vector<std::pair<std::type_index, std::size_t>> heap_sizes;
+    };
+
+    inline callback_registry& callback_heap_sizes() {
+      static auto registry = callback_registry{};
+      return registry;
+    }
+
+    template <typename F>
+    void register_callback() {
+      if constexpr (function_heap_size<F>() != 0) {
+        static const auto registered = [] {
+          auto& registry = callback_heap_sizes();
+          auto lock = std::lock_guard{registry.mutex};
+          registry.heap_sizes.emplace_back(typeid(F), function_heap_size<F>());
+          return true;
+        }();
+        (void)registered;
+      }
+    }
+
+    template <typename Sig>
+    std::size_t callback_heap_size(const std::function<Sig>& fn) {
+      if (!fn) {
+        return 0;
+      }
+
+      auto type = std::type_index(fn.target_type());
+      auto& registry = callback_heap_sizes();
+      auto lock = std::lock_guard{registry.mutex};
+
+      for (auto& [registered_type, heap_size] : registry.heap_sizes) {
+        if (registered_type == type) {
+          return heap_size;
+        }
+      }
+
+      return 0;
+    }
+  }
+
   /**
    * @ingroup behtree
    * @class node
@@ -167,6 +427,115 @@ namespace aitoolkit::bt {
 
       virtual execution_state evaluate(T& blackboard) const = 0;
 
+      /**
+       * @brief Reset the per-agent state of this node and its children
+       *
+       * This is called on a running subtree when it is interrupted.
+       */
+      virtual void halt() const {
+        for (auto& child : m_children) {
+          child->halt();
+        }
+      }
+
+      /**
+       * @brief Check if this node or one of its children keeps per-agent
+       * state, updated by `evaluate()`
+       *
+       * A tree without per-agent state can be shared between agents and
+       * threads. Nodes keeping such state need to override this method.
+       */
+      virtual bool has_agent_state() const {
+        return std::any_of(m_children.begin(), m_children.end(), [](auto& child) {
+          return child->has_agent_state();
+        });
+      }
+
+      /**
+       * @brief Create a deep copy of this node and its children, including
+       * their per-agent state
+       *
+       * Custom nodes must implement this method, they may return `nullptr`
+       * if they cannot be cloned. The clone of a node with an uncloneable
+       * child is also `nullptr`.
+       */
+      virtual std::unique_ptr<node<T>> clone() const = 0;
+
+      /**
+       * @brief Compute the memory used by this node and its children
+       */
+      memory_footprint footprint() const {
+        auto result = memory_footprint{};
+        collect_footprint(result);
+        return result;
+      }
+
+    protected:
+      static constexpr std::size_t no_child = static_cast<std::size_t>(-1);
+
+      /**
+       * @brief Halt the child which was running at the previous evaluation,
+       * unless it was evaluated again
+       *
+       * Composite nodes call this when they stop evaluating their children
+       * early, so that an abandoned subtree does not resume from a stale
+       * state the next time it is reached.
+       */
+      void halt_skipped_child(std::size_t running, bool evaluated) const {
+        if (running != no_child && !evaluated) {
+          m_children[running]->halt();
+        }
+      }
+
+      /**
+       * @brief Clone all the children of this node
+       *
+       * Returns an empty list if one of the children cannot be cloned.
+       */
+      std::vector<std::unique_ptr<node<T>>> clone_children() const {
+        auto children = std::vector<std::unique_ptr<node<T>>>{};
+        children.reserve(m_children.size());
+
+        for (auto& child : m_children) {
+          auto copy = child->clone();
+          if (!copy) {
+            return {};
+          }
+
+          children.push_back(std::move(copy));
+        }
+
+        return children;
+      }
+
+      /**
+       * @brief Add the memory used by this node and its children
+       *
+       * Custom nodes should override this method to report their real size
+       * and any heap storage they own, by default only the base class is
+       * accounted for.
+       */
+      virtual void collect_footprint(memory_footprint& footprint) const {
+        collect_node_footprint(footprint, sizeof(*this));
+      }
+
+      /**
+       * @brief Add the node object and its child vector to the footprint, then
+       * recurse into the children
+       */
+      void collect_node_footprint(memory_footprint& footprint, std::size_t node_size) const {
+        footprint.node_count += 1;
+        footprint.nodes += node_size;
+        footprint.children += m_children.size() * sizeof(m_children.front());
+        footprint.unused_capacity += (
+          (m_children.capacity() - m_children.size()) * sizeof(m_children.front())
+        );
+
+        for (auto& child : m_children) {
+          child->collect_footprint(footprint);
+        }
+      }
+
     protected:
       std::vector<std::unique_ptr<node<T>>> m_children;
   };
@@ -197,48 +566,321 @@ namespace aitoolkit::bt {
    * @ingroup behtree
    * @class seq
    * @brief Sequence node, will execute all children in order until one fails
+   *
+   * When a child keeps per-agent state, a running child which is not
+   * reached anymore by a later evaluation is halted. Otherwise, the node is
+   * stateless.
    */
   template <class T>
   class seq final : public node<T> {
     public:
       seq(std::vector<node_ptr<T>> children) {
         this->m_children = std::move(children);
+        m_tracks_running = this->has_agent_state();
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != this->m_children.size()) {
+          return nullptr;
+        }
+
+        auto copy = std::make_unique<seq>(std::move(children));
+        copy->m_running = m_running;
+        return copy;
       }
 
       virtual execution_state evaluate(T& blackboard) const override {
-        for (auto& child : this->m_children) {
-          auto state = child->evaluate(blackboard);
+        auto previous = node<T>::no_child;
+        if (m_tracks_running) {
+          previous = std::exchange(m_running, node<T>::no_child);
+        }
+
+        for (std::size_t idx = 0; idx < this->m_children.size(); idx++) {
+          auto state = this->m_children[idx]->evaluate(blackboard);
           if (state != execution_state::success) {
+            if (m_tracks_running) {
+              this->halt_skipped_child(previous, previous <= idx);
+
+              if (state == execution_state::running) {
+                m_running = idx;
+              }
+            }
+
             return state;
           }
         }
 
         return execution_state::success;
       }
+
+      virtual void halt() const override {
+        if (m_tracks_running) {
+          m_running = node<T>::no_child;
+        }
+
+        node<T>::halt();
+      }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+      }
+
+    private:
+      bool m_tracks_running{false};
+      mutable std::size_t m_running{node<T>::no_child};
   };
 
   /**
    * @ingroup behtree
    * @class sel
    * @brief Selector node, will execute all children in order until one succeeds
+   *
+   * When a child keeps per-agent state, a running child which is not
+   * reached anymore by a later evaluation is halted. Otherwise, the node is
+   * stateless.
    */
   template <class T>
   class sel final : public node<T> {
     public:
       sel(std::vector<node_ptr<T>> children) {
         this->m_children = std::move(children);
+        m_tracks_running = this->has_agent_state();
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != this->m_children.size()) {
+          return nullptr;
+        }
+
+        auto copy = std::make_unique<sel>(std::move(children));
+        copy->m_running = m_running;
+        return copy;
       }
 
       virtual execution_state evaluate(T& blackboard) const override {
-        for (auto& child : this->m_children) {
-          auto state = child->evaluate(blackboard);
+        auto previous = node<T>::no_child;
+        if (m_tracks_running) {
+          previous = std::exchange(m_running, node<T>::no_child);
+        }
+
+        for (std::size_t idx = 0; idx < this->m_children.size(); idx++) {
+          auto state = this->m_children[idx]->evaluate(blackboard);
           if (state != execution_state::failure) {
+            if (m_tracks_running) {
+              this->halt_skipped_child(previous, previous <= idx);
+
+              if (state == execution_state::running) {
+                m_running = idx;
+              }
+            }
+
             return state;
           }
         }
 
         return execution_state::failure;
       }
+
+      virtual void halt() const override {
+        if (m_tracks_running) {
+          m_running = node<T>::no_child;
+        }
+
+        node<T>::halt();
+      }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+      }
+
+    private:
+      bool m_tracks_running{false};
+      mutable std::size_t m_running{node<T>::no_child};
+  };
+
+  /**
+   * @ingroup behtree
+   * @class utility_sel
+   * @brief Utility selector node, will execute all children by descending
+   * score until one succeeds
+   *
+   * Each child is given a scoring function, like the `score()` method of
+   * `aitoolkit::utility::action`, there must be as many scoring functions as
+   * children. Scores are cached and only recomputed every
+   * `refresh_interval` evaluations, when the value returned by
+   * `inputs_version` changes, or after `mark_dirty()` was called. Children
+   * with equal scores keep their declaration order.
+   *
+   * The cache is per-agent state, updated by `evaluate()` even though it is
+   * `const`: a tree containing this node must not be shared between agents
+   * or threads, each agent needs its own clone.
+   */
+  template <class T>
+  class utility_sel final : public node<T> {
+    public:
+      using score_type = std::function<float(const T&)>;
+      using inputs_version_type = std::function<std::uint64_t(const T&)>;
+
+    public:
+      utility_sel(
+        std::vector<node_ptr<T>> children,
+        std::vector<score_type> scorers,
+        std::size_t refresh_interval = 1,
+        inputs_version_type inputs_version = nullptr
+      ) : m_scorers(std::move(scorers)),
+          m_refresh_interval(refresh_interval),
+          m_inputs_version(std::move(inputs_version))
+      {
+        assert(
+          children.size() == m_scorers.size() &&
+          "utility_sel needs one scoring function per child"
+        );
+        this->m_children = std::move(children);
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != this->m_children.size()) {
+          return nullptr;
+        }
+
+        auto copy = std::make_unique<utility_sel>(
+          std::move(children),
+          m_scorers,
+          m_refresh_interval,
+          m_inputs_version
+        );
+        copy->m_scores = m_scores;
+        copy->m_order = m_order;
+        copy->m_ticks_since_refresh = m_ticks_since_refresh;
+        copy->m_seen_version = m_seen_version;
+        copy->m_dirty = m_dirty;
+        copy->m_running = m_running;
+        return copy;
+      }
+
+      virtual execution_state evaluate(T& blackboard) const override {
+        // Checked by the constructor, only reached when assertions are
+        // disabled.
+        if (this->m_children.size() != m_scorers.size()) {
+          return execution_state::failure;
+        }
+
+        if (m_inputs_version) {
+          auto version = m_inputs_version(blackboard);
+          if (version != m_seen_version) {
+            m_seen_version = version;
+            m_dirty = true;
+          }
+        }
+
+        if (m_dirty || m_ticks_since_refresh >= m_refresh_interval) {
+          refresh_scores(blackboard);
+        }
+
+        m_ticks_since_refresh++;
+
+        auto previous = std::exchange(m_running, node<T>::no_child);
+        auto evaluated = false;
+
+        for (auto idx : m_order) {
+          auto state = this->m_children[idx]->evaluate(blackboard);
+          evaluated = evaluated || idx == previous;
+
+          if (state != execution_state::failure) {
+            this->halt_skipped_child(previous, evaluated);
+
+            if (state == execution_state::running) {
+              m_running = idx;
+            }
+
+            return state;
+          }
+        }
+
+        return execution_state::failure;
+      }
+
+      virtual void halt() const override {
+        m_dirty = true;
+        m_running = node<T>::no_child;
+        node<T>::halt();
+      }
+
+      virtual bool has_agent_state() const override {
+        return true;
+      }
+
+      /**
+       * @brief Force the scores to be recomputed on the next evaluation
+       */
+      void mark_dirty() const {
+        m_dirty = true;
+      }
+
+      /**
+       * @brief Get the cached score of a child
+       */
+      float score(std::size_t child_idx) const {
+        return m_scores[child_idx];
+      }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+        footprint.unused_capacity += (
+          (m_scorers.capacity() - m_scorers.size()) * sizeof(score_type)
+        );
+        footprint.callbacks += m_scorers.size() * sizeof(score_type);
+        footprint.callbacks += detail::callback_heap_size(m_inputs_version);
+
+        for (auto& scorer : m_scorers) {
+          footprint.callbacks += detail::callback_heap_size(scorer);
+        }
+
+        footprint.agent_state += (
+          m_scores.capacity() * sizeof(float) +
+          m_order.capacity() * sizeof(std::uint32_t)
+        );
+      }
+
+    private:
+      void refresh_scores(const T& blackboard) const {
+        m_scores.resize(m_scorers.size());
+        m_order.resize(m_scorers.size());
+
+        for (std::size_t idx = 0; idx < m_scorers.size(); idx++) {
+          m_scores[idx] = m_scorers[idx](blackboard);
+          m_order[idx] = static_cast<std::uint32_t>(idx);
+        }
+
+        std::stable_sort(
+          m_order.begin(),
+          m_order.end(),
+          [this](std::uint32_t a, std::uint32_t b) {
+            return m_scores[a] > m_scores[b];
+          }
+        );
+
+        m_ticks_since_refresh = 0;
+        m_dirty = false;
+      }
+
+    private:
+      std::vector<score_type> m_scorers;
+      std::size_t m_refresh_interval;
+      inputs_version_type m_inputs_version;
+
+      mutable std::vector<float> m_scores;
+      mutable std::vector<std::uint32_t> m_order;
+      mutable std::size_t m_ticks_since_refresh{0};
+      mutable std::uint64_t m_seen_version{0};
+      mutable bool m_dirty{true};
+      mutable std::size_t m_running{node<T>::no_child};
   };
 
   /**
@@ -255,6 +897,20 @@ namespace aitoolkit::bt {
         this->m_children.push_back(std::make_unique<N>(std::move(child)));
       }
 
+      neg(node_ptr<T> child) {
+        this->m_children.reserve(1);
+        this->m_children.push_back(std::move(child));
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != 1) {
+          return nullptr;
+        }
+
+        return std::make_unique<neg>(std::move(children.front()));
+      }
+
       virtual execution_state evaluate(T& blackboard) const override {
         if (this->m_children.size() != 1) {
           return execution_state::failure;
@@ -270,6 +926,11 @@ namespace aitoolkit::bt {
 
         return state;
       }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+      }
   };
 
   /**
@@ -283,7 +944,19 @@ namespace aitoolkit::bt {
       using callback_type = std::function<bool(const T&)>;
 
     public:
-      check(callback_type fn) : m_fn(fn) {}
+      template <typename F>
+      requires std::constructible_from<callback_type, F>
+      check(F fn) : m_fn(std::move(fn)) {
+        detail::register_callback<F>();
+      }
+
+      check(const check& other) : node<T>(), m_fn(other.m_fn) {}
+
+      check(check&& other) = default;
+
+      virtual node_ptr<T> clone() const override {
+        return std::make_unique<check>(*this);
+      }
 
       virtual execution_state evaluate(T& blackboard) const override {
         if (m_fn(blackboard)) {
@@ -293,6 +966,12 @@ namespace aitoolkit::bt {
         return execution_state::failure;
       }
 
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+        footprint.callbacks += detail::callback_heap_size(m_fn);
+      }
+
     private:
       callback_type m_fn;
   };
@@ -308,13 +987,315 @@ namespace aitoolkit::bt {
       using callback_type = std::function<execution_state(T&)>;
 
     public:
-      task(callback_type fn) : m_fn(fn) {}
+      template <typename F>
+      requires std::constructible_from<callback_type, F>
+      task(F fn) : m_fn(std::move(fn)) {
+        detail::register_callback<F>();
+      }
+
+      task(const task& other) : node<T>(), m_fn(other.m_fn) {}
+
+      task(task&& other) = default;
+
+      virtual node_ptr<T> clone() const override {
+        return std::make_unique<task>(*this);
+      }
 
       virtual execution_state evaluate(T& blackboard) const override {
         return m_fn(blackboard);
       }
 
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+        footprint.callbacks += detail::callback_heap_size(m_fn);
+      }
+
     private:
       callback_type m_fn;
   };
+
+  /**
+   * @ingroup behtree
+   * @class guard
+   * @brief Guard node, will execute the child only if the condition holds
+   *
+   * When used as a child of `reactive_sel`, the condition is watched as an
+   * abort guard. Otherwise, when the child keeps per-agent state, a running
+   * child is halted when the condition stops holding.
+   */
+  template <class T>
+  class guard final : public node<T> {
+    public:
+      template <node_trait<T> N>
+      guard(check<T> condition, N&& child) : m_condition(std::move(condition)) {
+        this->m_children.reserve(1);
+        this->m_children.push_back(std::make_unique<N>(std::move(child)));
+        m_tracks_running = this->has_agent_state();
+      }
+
+      guard(check<T> condition, node_ptr<T> child) : m_condition(std::move(condition)) {
+        this->m_children.reserve(1);
+        this->m_children.push_back(std::move(child));
+        m_tracks_running = this->has_agent_state();
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != 1) {
+          return nullptr;
+        }
+
+        auto copy = std::make_unique<guard>(m_condition, std::move(children.front()));
+        copy->m_running = m_running;
+        return copy;
+      }
+
+      virtual execution_state evaluate(T& blackboard) const override {
+        if (!m_tracks_running) {
+          return holds(blackboard) ? evaluate_child(blackboard) : execution_state::failure;
+        }
+
+        auto previous = std::exchange(m_running, false);
+
+        if (!holds(blackboard)) {
+          if (previous) {
+            this->m_children.front()->halt();
+          }
+
+          return execution_state::failure;
+        }
+
+        auto state = evaluate_child(blackboard);
+        m_running = state == execution_state::running;
+        return state;
+      }
+
+      virtual void halt() const override {
+        if (m_tracks_running) {
+          m_running = false;
+        }
+
+        node<T>::halt();
+      }
+
+      /**
+       * @brief Evaluate the condition only
+       */
+      bool holds(T& blackboard) const {
+        return m_condition.evaluate(blackboard) == execution_state::success;
+      }
+
+      /**
+       * @brief Evaluate the child without checking the condition
+       */
+      execution_state evaluate_child(T& blackboard) const {
+        if (this->m_children.size() != 1) {
+          return execution_state::failure;
+        }
+
+        return this->m_children.front()->evaluate(blackboard);
+      }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+        footprint.callbacks += m_condition.footprint().callbacks;
+      }
+
+    private:
+      check<T> m_condition;
+      bool m_tracks_running{false};
+      mutable bool m_running{false};
+  };
+
+  /**
+   * @ingroup behtree
+   * @class reactive_sel
+   * @brief Reactive selector node, will execute all children in order until
+   * one succeeds, and watch the guards of the higher priority children while
+   * one is running
+   *
+   * Once a child returns `running`, the next evaluations only re-evaluate the
+   * conditions of the `guard` children up to the running one. The running
+   * child is resumed directly, unless one of those conditions flipped: a
+   * higher priority condition became true, or the running child's own
+   * condition became false. In that case, the running child is halted and
+   * the children are evaluated again from the first one.
+   *
+   * Children that are not guards are considered to be always true, so they
+   * are only evaluated again once the running child finishes or is
+   * interrupted.
+   *
+   * The running child and the guard results are per-agent state, updated by
+   * `evaluate()` even though it is `const`: a tree containing this node must
+   * not be shared between agents or threads, each agent needs its own clone.
+   */
+  template <class T>
+  class reactive_sel final : public node<T> {
+    public:
+      reactive_sel(std::vector<node_ptr<T>> children) {
+        this->m_children = std::move(children);
+
+        m_guards.reserve(this->m_children.size());
+        for (auto& child : this->m_children) {
+          m_guards.push_back(dynamic_cast<const guard<T>*>(child.get()));
+        }
+
+        m_guard_results.resize(this->m_children.size(), 0);
+      }
+
+      virtual node_ptr<T> clone() const override {
+        auto children = this->clone_children();
+        if (children.size() != this->m_children.size()) {
+          return nullptr;
+        }
+
+        auto copy = std::make_unique<reactive_sel>(std::move(children));
+        copy->m_guard_results = m_guard_results;
+        copy->m_running = m_running;
+        return copy;
+      }
+
+      virtual execution_state evaluate(T& blackboard) const override {
+        if (m_running == node<T>::no_child) {
+          return evaluate_from(0, blackboard);
+        }
+
+        auto running = m_running;
+
+        for (std::size_t idx = 0; idx <= running; idx++) {
+          if (m_guards[idx] == nullptr) {
+            continue;
+          }
+
+          auto result = static_cast<std::uint8_t>(m_guards[idx]->holds(blackboard));
+          auto flipped = result != m_guard_results[idx];
+          m_guard_results[idx] = result;
+
+          if (flipped && (idx < running ? result : !result)) {
+            m_running = node<T>::no_child;
+            this->m_children[running]->halt();
+            return evaluate_from(0, blackboard);
+          }
+        }
+
+        m_running = node<T>::no_child;
+
+        auto state = evaluate_child(running, blackboard);
+        if (state == execution_state::running) {
+          m_running = running;
+          return state;
+        }
+        else if (state == execution_state::success) {
+          return state;
+        }
+
+        return evaluate_from(running + 1, blackboard);
+      }
+
+      virtual void halt() const override {
+        m_running = node<T>::no_child;
+        node<T>::halt();
+      }
+
+      virtual bool has_agent_state() const override {
+        return true;
+      }
+
+    protected:
+      virtual void collect_footprint(memory_footprint& footprint) const override {
+        this->collect_node_footprint(footprint, sizeof(*this));
+        footprint.children += m_guards.size() * sizeof(m_guards.front());
+        footprint.unused_capacity += (
+          (m_guards.capacity() - m_guards.size()) * sizeof(m_guards.front())
+        );
+        footprint.agent_state += m_guard_results.capacity() * sizeof(m_guard_results.front());
+      }
+
+    private:
+      execution_state evaluate_child(std::size_t idx, T& blackboard) const {
+        if (m_guards[idx] != nullptr) {
+          return m_guards[idx]->evaluate_child(blackboard);
+        }
+
+        return this->m_children[idx]->evaluate(blackboard);
+      }
+
+      execution_state evaluate_from(std::size_t first, T& blackboard) const {
+        for (std::size_t idx = first; idx < this->m_children.size(); idx++) {
+          if (m_guards[idx] != nullptr) {
+            auto result = static_cast<std::uint8_t>(m_guards[idx]->holds(blackboard));
+            m_guard_results[idx] = result;
+
+            if (!result) {
+              continue;
+            }
+          }
+
+          auto state = evaluate_child(idx, blackboard);
+          if (state == execution_state::running) {
+            m_running = idx;
+          }
+
+          if (state != execution_state::failure) {
+            return state;
+          }
+        }
+
+        return execution_state::failure;
+      }
+
+    private:
+      std::vector<const guard<T>*> m_guards;
+
+      mutable std::vector<std::uint8_t> m_guard_results;
+      mutable std::size_t m_running{node<T>::no_child};
+  };
+
+  /**
+   * @ingroup behtree
+   * @brief Instantiate many trees from a prototype
+   *
+   * Each clone is a deep copy of the prototype, including its per-agent
+   * state, and is written to `out`, which can point to preallocated slots.
+   * Returns the iterator past the last written tree, or `out` unchanged if
+   * the prototype cannot be cloned.
+   */
+  template <class T, typename OutputIt>
+  OutputIt clone_n(const node<T>& prototype, std::size_t count, OutputIt out) {
+    for (std::size_t i = 0; i < count; i++) {
+      auto copy = prototype.clone();
+      if (!copy) {
+        break;
+      }
+
+      *out = std::move(copy);
+      ++out;
+    }
+
+    return out;
+  }
+
+  /**
+   * @ingroup behtree
+   * @brief Compute the total memory used by a collection of trees
+   *
+   * The collection can hold the trees themselves or (smart) pointers to them.
+   */
+  template <class T, typename Range>
+  memory_footprint total_footprint(const Range& trees) {
+    auto result = memory_footprint{};
+
+    for (auto& tree : trees) {
+      if constexpr (std::derived_from<std::remove_cvref_t<decltype(tree)>, node<T>>) {
+        result += tree.footprint();
+      }
+      else {
+        result += tree->footprint();
+      }
+    }
+
+    return result;
+  }
 }
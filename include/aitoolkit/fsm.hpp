@@ -81,6 +81,16 @@ machine.set_state(state_dummy{}, blackboard);
 >  - if the machine is paused while transitioning to a new state, the new state
 >    will be paused as well
 
+To construct the new state in place instead, call `emplace_state()` with the
+arguments of the state's constructor:
+
+```cpp
+machine.emplace_state<state_dummy>(blackboard, arg1, arg2);
+```
+
+> **NB:** States only need to be movable, or not even movable when using
+> `emplace_state()`.
+
 To pause the machine, call `pause()`:
 
 ```cpp
@@ -135,6 +145,13 @@ machine.push_state(state_dummy{}, blackboard);
 > **NB:** This will call the `pause` method of the current state (if any) and
 > the `enter` method of the new state.
 
+Like with the simple state machine, `emplace_state()` constructs the new state
+in place:
+
+```cpp
+machine.emplace_state<state_dummy>(blackboard, arg1, arg2);
+```
+
 To pop the top state off the stack, call `pop_state()`:
 
 ```cpp
@@ -151,168 +168,4722 @@ machine.update(blackboard);
 ```
 
 > **NB:** This will call the `update` method of the top state (if any).
-*/
 
-#include <memory>
-#include <vector>
+When the maximum depth of the stack is known, the states can be stored inline
+instead of being allocated on the heap. The second template parameter is the
+capacity of the stack, the third one is the maximum size of a state (in
+bytes):
 
-#include <type_traits>
-#include <concepts>
+```cpp
+auto machine = stack_machine<blackboard_type, 4>{};
 
-namespace aitoolkit::fsm {
-  /**
-   * @ingroup fsm
-   * @class state
-   * @brief A state of the FSM.
-   */
-  template <typename T>
-  class state {
-    public:
-      virtual ~state() = default;
+if (!machine.push_state(state_dummy{}, blackboard)) {
+  // the stack is full, nothing was called
+}
+```
 
-      virtual void enter(T& blackboard) {};
-      virtual void exit(T& blackboard) {};
+> **NB:**
+>
+>  - `push_state()` and `emplace_state()` return `false` when the stack is
+>    full, and leave the machine untouched
+>  - a state too big or too aligned for its slot fails to compile
+>  - the fixed-capacity stack machine does not support deferred transitions
 
-      virtual void pause(T& blackboard) {};
-      virtual void resume(T& blackboard) {};
+### Orthogonal regions
 
-      virtual void update(T& blackboard) {};
-  };
+A machine can have several concurrent regions (for example locomotion, combat
+and dialogue), each one with its own current state. The states are stored
+inline, the second template parameter is the number of regions, the third
+one is the maximum size of a state (in bytes):
 
-  /**
-   * @ingroup fsm
-   * @brief Heap-allocated pointer to a state.
-   */
-  template <typename T>
-  using state_ptr = std::unique_ptr<state<T>>;
+```cpp
+enum region : std::size_t { locomotion, combat, dialogue };
 
-  template <typename S, typename T>
-  concept state_trait = std::derived_from<S, state<T>>;
+auto machine = orthogonal_machine<blackboard_type, 3>{};
 
-  /**
-   * @ingroup fsm
-   * @class simple_machine
-   * @brief A simple FSM.
-   */
-  template <typename T>
-  class simple_machine {
-    public:
-      /**
-       * @brief Enters in a new state, exiting the previous one (if any).
-       */
-      template <state_trait<T> S>
-      void set_state(S state, T& blackboard) {
-        if (m_current_state) {
-          m_current_state->exit(blackboard);
-        }
+machine.set_state(locomotion, state_walk{}, blackboard);
+machine.emplace_state<state_aim>(combat, blackboard, target);
 
-        m_current_state = std::make_unique<S>(state);
-        m_current_state->enter(blackboard);
+machine.update(blackboard); // locomotion, then combat, then dialogue
+```
 
-        if (m_paused) {
-          m_current_state->pause(blackboard);
-        }
-      }
+> **NB:**
+>
+>  - changing the state of a region only calls the `exit`/`enter` methods of
+>    this region
+>  - `pause()`, `resume()` and `update()` apply to every region with a state
+>  - a state too big or too aligned for its slot fails to compile
 
-      /**
-       * @brief Clear the current state.
-       */
-      void clear_state(T& blackboard) {
-        if (m_current_state) {
-          m_current_state->exit(blackboard);
-          m_current_state = nullptr;
-        }
-      }
+### Flyweight state machine
 
-      /**
-       * @brief Pause the machine.
-       */
-      void pause(T& blackboard) {
-        m_paused = true;
+When the states have no data of their own, a single instance of each state
+can be shared by all the machines. A flyweight machine only stores a pointer
+to its current state, and never allocates:
 
-        if (m_current_state) {
-          m_current_state->pause(blackboard);
-        }
-      }
+```cpp
+class state_idle final : public state<blackboard_type> {
+  public:
+    virtual void update(blackboard_type& blackboard) override {
+      // per-agent data lives in the blackboard
+      blackboard.idle_time++;
+    }
+};
 
-      /**
-       * @brief Resume the machine.
-       */
-      void resume(T& blackboard) {
-        m_paused = false;
+auto machine = flyweight_machine<blackboard_type>{};
 
-        if (m_current_state) {
-          m_current_state->resume(blackboard);
-        }
-      }
+machine.set_state<state_idle>(blackboard); // uses shared_state<state_idle>()
+// or: machine.set_state(my_shared_instance, blackboard);
 
-      /**
-       * @brief Update the machine.
-       */
-      void update(T& blackboard) {
-        if (m_paused) {
-          return;
-        }
+machine.update(blackboard);
+```
 
-        if (m_current_state) {
-          m_current_state->update(blackboard);
-        }
-      }
+> **NB:**
+>
+>  - the machine does not own its states, which must outlive it
+>  - as the same instance is used by many agents, possibly from many threads,
+>    its methods must only modify the blackboard
+>  - it provides the same `clear_state()`, `pause()`, `resume()` and
+>    `update()` methods as the simple state machine
 
-    private:
-      state_ptr<T> m_current_state{nullptr};
-      bool m_paused{false};
-  };
+### Snapshots
 
-  /**
-   * @ingroup fsm
-   * @class stack_machine
-   * @brief A stack FSM.
-   */
-  template <typename T>
-  class stack_machine {
-    public:
-      /**
-       * @brief Enters in a new state, pausing the previous one (if any).
-      */
-      template <state_trait<T> S>
-      void push_state(S state, T& blackboard) {
-        if (!m_state_stack.empty()) {
-          auto& current_state = m_state_stack.back();
-          current_state->pause(blackboard);
-        }
+The state of a machine can be saved into a compact binary buffer, and
+restored later, possibly in another process. The state types to save are
+registered first, and the registrations must be identical on both sides:
 
-        state.enter(blackboard);
-        m_state_stack.push_back(std::make_unique<S>(state));
-      }
+```cpp
+auto registry = state_registry<blackboard_type>{};
+registry.add<state_idle>();
+registry.add<state_chase>();
 
-      /**
-       * @brief Exits the current state, resuming the previous one (if any).
-       */
-      void pop_state(T& blackboard) {
-        if (!m_state_stack.empty()) {
-          auto& current_state = m_state_stack.back();
-          current_state->exit(blackboard);
-          m_state_stack.pop_back();
-        }
+auto writer = snapshot_writer{};
+for (auto& agent : agents) {
+  agent.machine.save(writer, registry);
+}
 
-        if (!m_state_stack.empty()) {
-          auto& current_state = m_state_stack.back();
-          current_state->resume(blackboard);
-        }
-      }
+auto buffer = writer.release();
+auto reader = snapshot_reader{buffer};
+for (auto& agent : agents) {
+  agent.machine.restore(reader, registry);
+}
+```
 
-      /**
-       * @brief Update the machine.
-       */
-      void update(T& blackboard) {
-        if (!m_state_stack.empty()) {
-          auto& current_state = m_state_stack.back();
-          current_state->update(blackboard);
-        }
-      }
+Registered states must be default-constructible. A state with some data to
+save implements `save()` and `load()`:
 
-    private:
-      std::vector<state_ptr<T>> m_state_stack;
+```cpp
+class state_chase final : public state<blackboard_type> {
+  public:
+    void save(snapshot_writer& writer) const {
+      writer.write_varint(m_target);
+    }
+
+    bool load(snapshot_reader& reader) {
+      return reader.read_varint(m_target);
+    }
+
+    // ...
+
+  private:
+    std::uint64_t m_target{0};
+};
+```
+
+> **NB:**
+>
+>  - the simple state machine saves its current state and its paused flag,
+>    the stack state machine saves its whole stack
+>  - `restore()` does not call the `exit`/`enter` methods, and drops the
+>    pending deferred transitions
+>  - `save()` returns `false` if a state is not registered, `restore()`
+>    returns `false` if the snapshot is invalid
+>  - `write()`/`read()` copy values in the native byte order
+
+### Coroutine states
+
+A state with several phases can be written as a coroutine, instead of a
+switch over a phase field evaluated at every update:
+
+```cpp
+class state_attack final : public coroutine_state<blackboard_type> {
+  public:
+    virtual state_task run(blackboard_type& blackboard) override {
+      blackboard.play("wind-up");
+      co_await wait_ticks{20};
+
+      blackboard.strike();
+      co_await wait_until{[&]() { return blackboard.animation_done(); }};
+
+      blackboard.play("recover");
+      co_await wait_event{event_recovered};
+
+      blackboard.attack_done = true;
+    }
+};
+```
+
+The coroutine starts at the first update after `enter`, and is resumed by the
+next updates once what it awaits is ready:
+
+ - `next_tick{}`: the next update
+ - `wait_ticks{n}`: the n-th next update
+ - `wait_until{predicate}`: the first update where `predicate()` is true
+ - `wait_event{event}`: when `notify(event)` is called on the state
+
+> **NB:**
+>
+>  - `exit` destroys the coroutine, a state overriding `enter`, `exit` or
+>    `update` must call the `coroutine_state` implementation
+>  - the coroutine frames come from a thread-local pool, by size class
+>  - a coroutine must not transition its own machine immediately, as this
+>    would destroy it while it runs: use deferred transitions instead
+>  - the coroutine keeps a pointer to its state and a reference to the
+>    blackboard, neither may move while the state is active: coroutine states
+>    cannot be copied nor moved, and are rejected by `machine_pool` and
+>    `machine_scheduler`, which move their states or blackboards
+
+### Instrumentation
+
+Both machines take an optional recorder, notified of every transition and
+update. With the default `no_recorder`, the instrumentation compiles out.
+`machine_stats` counts the transitions per pair of states, the time spent in
+each state and the latency of the updates:
+
+```cpp
+auto machine = simple_machine<blackboard_type, machine_stats>{};
+// or: stack_machine<blackboard_type, 0, 64, machine_stats>{};
+
+// ...
+
+auto stats = machine_stats{};
+stats.merge(machine.recorder()); // aggregate the stats of many machines
+
+auto flips = stats.transition_count<state_chase, state_flee>();
+
+if (auto entry = stats.find<state_chase>()) {
+  // entry->time_in_state, entry->update_count, entry->max_update_time, ...
+}
+```
+
+> **NB:**
+>
+>  - states are identified by their dynamic type, "no state" is `void`
+>  - the time spent in a state is accounted when exiting it
+>  - with the stack state machine, a transition is a change of the top state
+
+To diagnose oscillations, `transition_history<N>` is a recorder keeping the
+last `N` transitions of a machine in a ring buffer, with the number of updates
+before each one:
+
+```cpp
+auto machine = simple_machine<blackboard_type, transition_history<16>>{};
+
+// ...
+
+auto& history = machine.recorder();
+for (std::size_t i = 0; i < history.size(); i++) {
+  auto& entry = history[i]; // entry.tick, entry.from, entry.to
+}
+```
+
+A machine pool can also record the last transitions of all its machines, in a
+single buffer allocated when the machines are added:
+
+```cpp
+pool.enable_history(16);
+
+// ...
+
+pool.dump_history([](machine_id id, const auto& entry) {
+  // entry.tick, entry.from, entry.to are the pool tick and state identifiers
+});
+```
+
+### Deferred transitions
+
+By default, transitions are applied as soon as they are requested. To update
+many machines in parallel, the transitions can be recorded instead, and
+applied later in a separate, single-threaded, commit phase:
+
+```cpp
+struct agent_type {
+  blackboard_type blackboard;
+  simple_machine<blackboard_type> machine{transition_mode::deferred};
+};
+
+// in parallel, the states can call set_state()/clear_state():
+std::for_each(std::execution::par, agents.begin(), agents.end(), [](auto& agent) {
+  agent.machine.update(agent.blackboard);
+});
+
+// then, in a deterministic order:
+for (auto& agent : agents) {
+  agent.machine.commit(agent.blackboard);
+}
+```
+
+> **NB:**
+>
+>  - the `enter`/`exit`/`pause`/`resume` methods are only called by `commit()`
+>  - the simple state machine only applies the last requested transition
+>  - the stack state machine applies all the `push_state()`/`pop_state()`
+>    calls, in order
+
+### Static state machine
+
+When all the states are known at compile time, the current state can be
+stored inline, without any heap allocation on transition:
+
+```cpp
+using namespace aitoolkit::fsm;
+
+auto machine = static_machine<blackboard_type, state_idle, state_patrol, state_chase>{};
+```
+
+It has the same interface as the simple state machine:
+
+```cpp
+machine.set_state(state_patrol{}, blackboard);
+machine.pause(blackboard);
+machine.resume(blackboard);
+machine.update(blackboard);
+machine.clear_state(blackboard);
+```
+
+> **NB:** The current state is held in a `std::variant`, the state methods are
+> dispatched with `std::visit` on the concrete state type, so they are not
+> virtual calls.
+
+### Enum state machine
+
+For lightweight machines (projectiles, pickups, doors, ...), the states can be
+the enumerators of an enum, with handlers overloaded on a `state_tag`. The
+transition table is declared in a traits type, and validated at compile
+time:
+
+```cpp
+struct door_traits {
+  enum class state { closed, opening, open, closing };
+
+  static constexpr std::size_t state_count = 4;
+
+  static constexpr auto transitions = std::array{
+    enum_transition{state::closed, state::opening},
+    enum_transition{state::opening, state::open},
+    enum_transition{state::open, state::closing},
+    enum_transition{state::closing, state::closed},
+  };
+
+  static void enter(state_tag<state::opening>, door_type& door) {
+    door.play("open");
+  }
+
+  static void update(state_tag<state::opening>, door_type& door) {
+    door.angle += door.speed;
+  }
+
+  // handlers can be omitted, or generic:
+  static void update(auto, door_type& door) {}
+};
+
+auto machine = enum_machine<door_type, door_traits>{};
+machine.set_state<door_traits::state::closed>(door);
+
+if (!machine.transition_to<door_traits::state::opening>(door)) {
+  // no transition from the current state
+}
+
+machine.update(door);
+```
+
+> **NB:**
+>
+>  - the handlers are not virtual, `update()` compiles to a switch over the
+>    current state
+>  - a table with unknown states or duplicate transitions, or a
+>    `transition_to()` a state without incoming transitions, fails to compile
+>  - `set_state()` does not check the table, it is meant to start the machine
+
+### Indexed state machine
+
+When a machine keeps cycling through the same states, they can be registered
+once, and reused on every transition instead of being destroyed and created
+again:
+
+```cpp
+using namespace aitoolkit::fsm;
+
+using guard_machine = indexed_machine<blackboard_type, state_idle, state_patrol, state_chase>;
+
+auto machine = guard_machine{state_idle{}, state_patrol{}, state_chase{}};
+```
+
+To transition to a state, call `transition_to()` with its identifier, which is
+its position in the list of states:
+
+```cpp
+machine.transition_to(guard_machine::id_of<state_patrol>(), blackboard);
+// or:
+machine.transition_to<state_patrol>(blackboard);
+```
+
+> **NB:** As the state objects are reused, the `enter` method should reset any
+> data the state keeps between transitions.
+
+It also provides `clear_state()`, `pause()`, `resume()` and `update()`.
+
+### Event state machine
+
+Instead of deciding transitions inside the `update` method of each state, a
+machine can react to events with a transition table. States and events are
+identified by integers or enumerations:
+
+```cpp
+using namespace aitoolkit::fsm;
+
+enum class door_state { closed, open, locked, count };
+enum class door_event { push, pull, lock, unlock, count };
+
+auto machine = event_machine<blackboard_type, door_state, door_event>(
+  door_state::count,
+  door_event::count,
+  {
+    {door_state::closed, door_event::push, door_state::open},
+    {door_state::open, door_event::pull, door_state::closed},
+    {door_state::closed, door_event::lock, door_state::locked, [](blackboard_type& bb) {
+      // optional action, executed during the transition
+    }},
+    {door_state::locked, door_event::unlock, door_state::closed}
+  },
+  door_state::closed
+);
+```
+
+The transitions are compiled into a dense table when the machine is built, so
+dispatching an event is a single indexed load:
+
+```cpp
+machine.dispatch(door_event::push, blackboard); // true, door is now open
+machine.dispatch(door_event::lock, blackboard); // false, nothing happens
+machine.current_state(); // door_state::open
+```
+
+> **NB:** Actions are plain function pointers, captureless lambdas can be
+> used.
+
+Events can also be posted from other threads to an `event_queue`, and
+dispatched in one batch by the thread owning the blackboard:
+
+```cpp
+auto queue = event_queue<door_event>(1024);
+
+// from any thread:
+queue.try_push(door_event::push);
+
+// from the thread owning the machine:
+machine.dispatch_queued(queue, blackboard);
+```
+
+### Hierarchical state machine
+
+States can be nested inside composite states. First, register the states,
+with their parent state (if any):
+
+```cpp
+using namespace aitoolkit::fsm;
+
+auto machine = hierarchical_machine<blackboard_type>{};
+
+auto alive = machine.add_state(state_alive{});
+auto idle = machine.add_state(state_idle{}, alive);
+auto combat = machine.add_state(state_combat{}, alive);
+auto attack = machine.add_state(state_attack{}, combat);
+auto dodge = machine.add_state(state_dodge{}, combat);
+auto dead = machine.add_state(state_dead{});
+
+machine.set_initial_state(alive, idle);
+machine.set_initial_state(combat, attack);
+
+machine.build();
+```
+
+Then, transition to any state:
+
+```cpp
+machine.transition_to(combat, blackboard); // enters combat, then attack
+machine.transition_to(dodge, blackboard);  // exits attack, enters dodge
+machine.transition_to(dead, blackboard);   // exits dodge, combat, alive
+```
+
+> **NB:**
+>
+>  - `build()` computes the least common ancestor of every pair of states, so
+>    that transitions do not walk the hierarchy (it is called by the first
+>    transition if needed)
+>  - the `exit` methods are called from the innermost state, the `enter`
+>    methods from the outermost state
+>  - transitioning to a composite state enters its initial substate (if any)
+>  - the target state is always exited and entered again, even if it is
+>    already active
+
+Updating the machine calls the `update` method of every active state, from
+the outermost to the innermost:
+
+```cpp
+machine.update(blackboard);
+```
+
+It also provides `clear_state()`, `pause()` and `resume()`.
+
+### Machine pool
+
+To update many machines, a pool holds them with their blackboards. The set of
+possible states is known at compile time, and the machines are updated grouped
+by their current state, so that the code and data of one state stay hot in
+cache:
+
+```cpp
+using namespace aitoolkit::fsm;
+
+auto pool = machine_pool<blackboard_type, state_idle, state_patrol, state_chase>{};
+
+auto agent = pool.add_machine(blackboard_type{});
+pool.set_state(agent, state_patrol{});
+// or: pool.emplace_state<state_patrol>(agent, args...);
+
+pool.update(); // all machines in state_idle, then state_patrol, then state_chase
+```
+
+> **NB:**
+>
+>  - the states are stored by value in one dense array per state type, which
+>    is updated on transition
+>  - transitions requested while the pool is updating are applied once all
+>    the machines have been updated
+>  - machines must not be added while the pool is updating
+
+Other threads can request transitions through an `event_queue`, which is
+drained at the start of the update:
+
+```cpp
+using pool_type = machine_pool<blackboard_type, state_idle, state_patrol, state_chase>;
+
+auto requests = event_queue<pool_type::transition_request>(1024);
+
+// from any thread:
+requests.try_push({agent, state_chase{}});
+
+// from the thread owning the pool:
+pool.update(requests);
+```
+
+Events are routed to the machines whose current state handles them. A state
+handles events of type `E` by implementing `on_event()`:
+
+```cpp
+struct alarm_raised {
+  float x, y;
+};
+
+class state_patrol final : public state<blackboard_type> {
+  public:
+    void on_event(const alarm_raised& event, blackboard_type& blackboard) {
+      // ...
+    }
+};
+
+pool.broadcast(alarm_raised{x, y}); // only visits the machines in state_patrol
+pool.send(agent, alarm_raised{x, y});
+```
+
+> **NB:**
+>
+>  - the per-state arrays are the subscription lists: entering or exiting a
+>    state subscribes or unsubscribes the machine, at no extra cost
+>  - the states not handling an event are skipped at compile time
+>  - transitions requested while handling an event are applied once the
+>    event has been delivered
+
+Machines can be added to groups (for example, one per zone of the world),
+which are paused, resumed or cleared in O(1):
+
+```cpp
+auto agent = pool.add_machine(blackboard_type{}, zone_id);
+
+pool.pause_group(zone_id);  // the machines of the zone are skipped by update()
+pool.resume_group(zone_id);
+pool.clear_group(zone_id);  // the machines of the zone lose their state
+```
+
+> **NB:**
+>
+>  - group 0 exists by default, the other groups are created when a machine is
+>    added to them; group identifiers must be lower than `max_group_count`,
+>    `add_machine` returns `no_machine` otherwise
+>  - the per-state arrays are partitioned by group: once its machines have
+>    been paused, a paused group is skipped as a whole by `update()`, and
+>    entering or exiting a state costs O(number of groups)
+>  - the `pause`/`resume`/`exit` methods of the states are called lazily, when
+>    the machine is next updated, receives an event or is transitioned, and a
+>    pause followed by a resume before that calls neither
+>  - group operations requested during an update are applied once it completes
+>  - `count()` and `subscriber_count()` still include the machines of a
+>    cleared group until their `exit` method is called
+
+### Event queue
+
+An `event_queue` is a bounded, lock-free, multi-producer single-consumer
+queue. Any thread can call `try_push()`, which returns `false` when the queue
+is full, but only one thread can call `try_pop()` or `drain()`.
+
+### Machine scheduler
+
+Most machines spend their time waiting (idling, cooling down, guarding). A
+scheduler holds simple machines with their blackboards, and only updates the
+ones whose wake time has arrived. After entering and after every update, a
+state tells when it wants to be updated next with a `next_update()` method
+(see the `scheduled_state` concept):
+
+```cpp
+class state_cooldown final : public state<blackboard_type> {
+  public:
+    virtual void update(blackboard_type& blackboard) override {
+      // ...
+    }
+
+    tick_type next_update(blackboard_type& blackboard, tick_type now) {
+      return now + 30; // or wake_on_event
+    }
+};
+
+auto scheduler = machine_scheduler<blackboard_type>{};
+
+auto agent = scheduler.add_machine(blackboard_type{});
+scheduler.set_state(agent, state_cooldown{});
+
+scheduler.update(); // once per frame, only updates the machines due now
+scheduler.wake(agent); // updated at the next call to update()
+```
+
+> **NB:**
+>
+>  - by default, a state is updated at every tick
+>  - a state returning `wake_on_event` is only updated again after `wake()`
+>  - the states entered through `machine()` are updated at every tick, unless
+>    they have the type of the last state entered with `set_state()` or
+>    `emplace_state()` of the scheduler
+>  - when changing the machine returned by `machine()` outside of an update,
+>    call `wake()` so that the new state is scheduled
+>  - a paused machine is not scheduled, call `wake()` after resuming it
+>  - machines must not be added while the scheduler is updating
+*/
+
+#include <algorithm>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <new>
+#include <variant>
+#include <tuple>
+#include <array>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <span>
+#include <cstring>
+#include <coroutine>
+#include <exception>
+
+#include <type_traits>
+#include <concepts>
+
+namespace aitoolkit::fsm {
+  /**
+   * @ingroup fsm
+   * @brief Time, in updates of a `machine_scheduler`.
+   */
+  using tick_type = std::uint64_t;
+
+  /**
+   * @ingroup fsm
+   * @brief Wake time of a state that only wakes up on `machine_scheduler::wake()`.
+   */
+  inline constexpr tick_type wake_on_event = tick_type(-1);
+
+  /**
+   * @ingroup fsm
+   * @class state
+   * @brief A state of the FSM.
+   */
+  template <typename T>
+  class state {
+    public:
+      virtual ~state() = default;
+
+      virtual void enter(T& blackboard) {};
+      virtual void exit(T& blackboard) {};
+
+      virtual void pause(T& blackboard) {};
+      virtual void resume(T& blackboard) {};
+
+      virtual void update(T& blackboard) {};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Heap-allocated pointer to a state.
+   */
+  template <typename T>
+  using state_ptr = std::unique_ptr<state<T>>;
+
+  template <typename S, typename T>
+  concept state_trait = std::derived_from<S, state<T>>;
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier of a state in a machine with a fixed set of states.
+   */
+  using state_id = std::size_t;
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier used when a machine has no current state.
+   */
+  inline constexpr state_id no_state = static_cast<state_id>(-1);
+
+  /**
+   * @ingroup fsm
+   * @enum transition_mode
+   * @brief When the transitions of a machine are applied.
+   */
+  enum class transition_mode {
+    immediate, /**< Transitions are applied when requested */
+    deferred   /**< Transitions are recorded, and applied by `commit()` */
+  };
+
+  /**
+   * @ingroup fsm
+   * @struct no_recorder
+   * @brief Recorder of a machine without instrumentation, it compiles out.
+   */
+  struct no_recorder {
+    static constexpr bool enabled = false;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class machine_stats
+   * @brief Recorder of a machine counting the transitions, the time spent in
+   * each state and the latency of `update`.
+   *
+   * States are identified by their dynamic type, `void` stands for "no
+   * state".
+   */
+  class machine_stats {
+    public:
+      static constexpr bool enabled = true;
+
+      using clock = std::chrono::steady_clock;
+
+      /**
+       * @brief Number of transitions between two states.
+       */
+      struct transition_entry {
+        std::type_index from;
+        std::type_index to;
+        std::size_t count{0};
+      };
+
+      /**
+       * @brief Time spent in a state and latency of its updates.
+       */
+      struct state_entry {
+        std::type_index state;
+        clock::duration time_in_state{0};
+        std::size_t update_count{0};
+        clock::duration update_time{0};
+        clock::duration max_update_time{0};
+      };
+
+      /**
+       * @brief Called by the machine when it changes its current state.
+       *
+       * The time since the previous transition is added to the time spent in
+       * the exited state.
+       */
+      void record_transition(std::type_index from, std::type_index to) {
+        auto now = clock::now();
+
+        if (from != std::type_index(typeid(void))) {
+          entry(from).time_in_state += now - m_entered_at;
+        }
+
+        m_entered_at = now;
+        transition(from, to).count++;
+      }
+
+      /**
+       * @brief Called by the machine after updating its current state.
+       */
+      void record_update(std::type_index state, clock::duration latency) {
+        auto& e = entry(state);
+        e.update_count++;
+        e.update_time += latency;
+        e.max_update_time = std::max(e.max_update_time, latency);
+      }
+
+      /**
+       * @brief Add the statistics of another machine.
+       */
+      void merge(const machine_stats& other) {
+        for (auto& t : other.m_transitions) {
+          transition(t.from, t.to).count += t.count;
+        }
+
+        for (auto& o : other.m_states) {
+          auto& e = entry(o.state);
+          e.time_in_state += o.time_in_state;
+          e.update_count += o.update_count;
+          e.update_time += o.update_time;
+          e.max_update_time = std::max(e.max_update_time, o.max_update_time);
+        }
+      }
+
+      /**
+       * @brief Forget all the statistics.
+       */
+      void reset() {
+        m_transitions.clear();
+        m_states.clear();
+      }
+
+      const std::vector<transition_entry>& transitions() const {
+        return m_transitions;
+      }
+
+      const std::vector<state_entry>& states() const {
+        return m_states;
+      }
+
+      /**
+       * @brief Number of transitions from `From` to `To`.
+       */
+      template <typename From, typename To>
+      std::size_t transition_count() const {
+        auto from = std::type_index(typeid(From));
+        auto to = std::type_index(typeid(To));
+
+        for (auto& t : m_transitions) {
+          if (t.from == from && t.to == to) {
+            return t.count;
+          }
+        }
+
+        return 0;
+      }
+
+      /**
+       * @brief Statistics of the state `S`, `nullptr` if it was never entered
+       * nor updated.
+       */
+      template <typename S>
+      const state_entry* find() const {
+        auto state = std::type_index(typeid(S));
+
+        for (auto& e : m_states) {
+          if (e.state == state) {
+            return &e;
+          }
+        }
+
+        return nullptr;
+      }
+
+    private:
+      // Machines have a handful of states, a linear search beats hashing.
+      transition_entry& transition(std::type_index from, std::type_index to) {
+        for (auto& t : m_transitions) {
+          if (t.from == from && t.to == to) {
+            return t;
+          }
+        }
+
+        return m_transitions.emplace_back(transition_entry{from, to});
+      }
+
+      state_entry& entry(std::type_index state) {
+        for (auto& e : m_states) {
+          if (e.state == state) {
+            return e;
+          }
+        }
+
+        return m_states.emplace_back(state_entry{state});
+      }
+
+    private:
+      std::vector<transition_entry> m_transitions;
+      std::vector<state_entry> m_states;
+      clock::time_point m_entered_at{};
+  };
+
+  /**
+   * @ingroup fsm
+   * @class transition_history
+   * @brief Recorder of a machine keeping its last `N` transitions in a ring
+   * buffer.
+   *
+   * The tick of a transition is the number of updates of the machine before
+   * it. Nothing is allocated after construction, and the updates are not
+   * timed.
+   */
+  template <std::size_t N>
+  requires (N > 0)
+  class transition_history {
+    public:
+      static constexpr bool enabled = true;
+      static constexpr bool measure_updates = false;
+
+      /**
+       * @brief A recorded transition, `void` stands for "no state".
+       */
+      struct entry {
+        tick_type tick{0};
+        std::type_index from{typeid(void)};
+        std::type_index to{typeid(void)};
+      };
+
+      void record_transition(std::type_index from, std::type_index to) {
+        m_entries[m_total % N] = entry{m_tick, from, to};
+        m_total++;
+      }
+
+      void record_update(std::type_index, std::chrono::steady_clock::duration) {
+        m_tick++;
+      }
+
+      /**
+       * @brief Number of recorded transitions, at most `N`.
+       */
+      std::size_t size() const {
+        return m_total < N ? static_cast<std::size_t>(m_total) : N;
+      }
+
+      static constexpr std::size_t capacity() {
+        return N;
+      }
+
+      /**
+       * @brief Number of transitions since the construction, including the
+       * overwritten ones.
+       */
+      std::uint64_t total() const {
+        return m_total;
+      }
+
+      /**
+       * @brief Get a recorded transition, from the oldest (`0`) to the most
+       * recent (`size() - 1`).
+       */
+      const entry& operator[](std::size_t idx) const {
+        return m_entries[(m_total - size() + idx) % N];
+      }
+
+      /**
+       * @brief Forget the recorded transitions.
+       */
+      void clear() {
+        m_total = 0;
+      }
+
+    private:
+      std::array<entry, N> m_entries{};
+      std::uint64_t m_total{0};
+      tick_type m_tick{0};
+  };
+
+  namespace detail {
+    // Position of `S` in `States`, or `no_state`.
+    template <typename S, typename... States>
+    constexpr state_id index_of() {
+      constexpr auto matches = std::array<bool, sizeof...(States)>{std::same_as<S, States>...};
+
+      for (state_id id = 0; id < matches.size(); id++) {
+        if (matches[id]) {
+          return id;
+        }
+      }
+
+      return no_state;
+    }
+
+    template <typename T>
+    std::type_index state_type(const state<T>* s) {
+      return s != nullptr ? std::type_index(typeid(*s)) : std::type_index(typeid(void));
+    }
+
+    template <typename R>
+    constexpr bool measures_updates() {
+      if constexpr (requires { R::measure_updates; }) {
+        return R::measure_updates;
+      }
+      else {
+        return true;
+      }
+    }
+
+    template <typename T, typename R>
+    void recorded_update(R& recorder, state<T>* current_state, T& blackboard) {
+      auto type = state_type<T>(current_state);
+
+      if constexpr (measures_updates<R>()) {
+        auto start = std::chrono::steady_clock::now();
+        current_state->update(blackboard);
+        recorder.record_update(type, std::chrono::steady_clock::now() - start);
+      }
+      else {
+        current_state->update(blackboard);
+        recorder.record_update(type, std::chrono::steady_clock::duration::zero());
+      }
+    }
+  }
+
+  /**
+   * @ingroup fsm
+   * @class snapshot_writer
+   * @brief Binary buffer receiving the snapshots of machines.
+   */
+  class snapshot_writer {
+    public:
+      /**
+       * @brief Write an unsigned integer in 1 to 10 bytes (LEB128).
+       */
+      void write_varint(std::uint64_t value) {
+        while (value >= 0x80) {
+          m_buffer.push_back(static_cast<std::byte>((value & 0x7f) | 0x80));
+          value >>= 7;
+        }
+
+        m_buffer.push_back(static_cast<std::byte>(value));
+      }
+
+      /**
+       * @brief Write the bytes of a value, in the native byte order.
+       */
+      template <typename V>
+      requires std::is_trivially_copyable_v<V>
+      void write(const V& value) {
+        auto bytes = reinterpret_cast<const std::byte*>(&value);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(V));
+      }
+
+      const std::vector<std::byte>& data() const {
+        return m_buffer;
+      }
+
+      /**
+       * @brief Take the written bytes, leaving the writer empty.
+       */
+      std::vector<std::byte> release() {
+        return std::exchange(m_buffer, {});
+      }
+
+    private:
+      std::vector<std::byte> m_buffer;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class snapshot_reader
+   * @brief Cursor over the snapshots of machines.
+   *
+   * Every read returns `false` if the buffer is too short.
+   */
+  class snapshot_reader {
+    public:
+      snapshot_reader(std::span<const std::byte> data) : m_data(data) {}
+
+      /**
+       * @brief Read an unsigned integer written by `write_varint()`.
+       */
+      bool read_varint(std::uint64_t& value) {
+        value = 0;
+
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+          if (m_offset == m_data.size()) {
+            return false;
+          }
+
+          auto byte = std::to_integer<std::uint64_t>(m_data[m_offset++]);
+
+          // The 10th byte only holds the 64th bit.
+          if (shift == 63 && byte > 1) {
+            return false;
+          }
+
+          value |= (byte & 0x7f) << shift;
+
+          if ((byte & 0x80) == 0) {
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      /**
+       * @brief Read a value written by `write()`.
+       */
+      template <typename V>
+      requires std::is_trivially_copyable_v<V>
+      bool read(V& value) {
+        if (remaining() < sizeof(V)) {
+          return false;
+        }
+
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(V));
+        m_offset += sizeof(V);
+        return true;
+      }
+
+      /**
+       * @brief Number of bytes left to read.
+       */
+      std::size_t remaining() const {
+        return m_data.size() - m_offset;
+      }
+
+    private:
+      std::span<const std::byte> m_data;
+      std::size_t m_offset{0};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief A state with a payload in snapshots.
+   */
+  template <typename S>
+  concept snapshot_payload = requires(S& s, const S& cs, snapshot_writer& w, snapshot_reader& r) {
+    { cs.save(w) } -> std::same_as<void>;
+    { s.load(r) } -> std::same_as<bool>;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class state_registry
+   * @brief Identifiers of the state types that can be saved in a snapshot.
+   *
+   * States are restored by default-constructing them, then calling their
+   * `load()` method if they have a payload (see `snapshot_payload`).
+   */
+  template <typename T>
+  class state_registry {
+    public:
+      /**
+       * @brief Register a state type, returns its identifier.
+       *
+       * Identifiers are given in registration order, so the registrations
+       * must be the same when saving and restoring.
+       */
+      template <state_trait<T> S>
+      requires std::default_initializable<S>
+      state_id add() {
+        auto type = std::type_index(typeid(S));
+
+        if (auto it = m_ids.find(type); it != m_ids.end()) {
+          return it->second;
+        }
+
+        auto id = m_entries.size();
+        m_entries.push_back(entry{
+          .size = sizeof(S),
+          .align = alignof(S),
+          .save = &save_state<S>,
+          .make = &make_state<S>,
+          .construct = &construct_state<S>
+        });
+        m_ids.emplace(type, id);
+        return id;
+      }
+
+      /**
+       * @brief Identifier of a state type, `no_state` if it is not registered.
+       */
+      template <state_trait<T> S>
+      state_id id_of() const {
+        return id_of(std::type_index(typeid(S)));
+      }
+
+      /**
+       * @brief Identifier of the dynamic type of a state, `no_state` if it is
+       * not registered.
+       */
+      state_id id_of(const state<T>& state) const {
+        return id_of(std::type_index(typeid(state)));
+      }
+
+      /**
+       * @brief Number of registered state types.
+       */
+      std::size_t size() const {
+        return m_entries.size();
+      }
+
+      /**
+       * @brief Write the payload of a state (if any).
+       */
+      void save_payload(state_id id, const state<T>& state, snapshot_writer& writer) const {
+        m_entries[id].save(state, writer);
+      }
+
+      /**
+       * @brief Allocate a state and read its payload, `nullptr` on failure.
+       */
+      state_ptr<T> make(state_id id, snapshot_reader& reader) const {
+        if (id >= m_entries.size()) {
+          return nullptr;
+        }
+
+        return m_entries[id].make(reader);
+      }
+
+      /**
+       * @brief Construct a state in `storage` and read its payload, `nullptr`
+       * on failure or if it does not fit.
+       */
+      state<T>* construct(
+        state_id id,
+        snapshot_reader& reader,
+        void* storage,
+        std::size_t size,
+        std::size_t align
+      ) const {
+        if (id >= m_entries.size()) {
+          return nullptr;
+        }
+
+        auto& e = m_entries[id];
+        if (e.size > size || e.align > align) {
+          return nullptr;
+        }
+
+        return e.construct(reader, storage);
+      }
+
+    private:
+      struct entry {
+        std::size_t size;
+        std::size_t align;
+        void (*save)(const state<T>&, snapshot_writer&);
+        state_ptr<T> (*make)(snapshot_reader&);
+        state<T>* (*construct)(snapshot_reader&, void*);
+      };
+
+      state_id id_of(std::type_index type) const {
+        auto it = m_ids.find(type);
+        return it != m_ids.end() ? it->second : no_state;
+      }
+
+      template <typename S>
+      static void save_state(const state<T>& state, snapshot_writer& writer) {
+        if constexpr (snapshot_payload<S>) {
+          static_cast<const S&>(state).save(writer);
+        }
+      }
+
+      template <typename S>
+      static state_ptr<T> make_state(snapshot_reader& reader) {
+        auto state = std::make_unique<S>();
+
+        if constexpr (snapshot_payload<S>) {
+          if (!state->load(reader)) {
+            return nullptr;
+          }
+        }
+
+        return state;
+      }
+
+      template <typename S>
+      static state<T>* construct_state(snapshot_reader& reader, void* storage) {
+        auto state = std::construct_at(static_cast<S*>(storage));
+
+        if constexpr (snapshot_payload<S>) {
+          if (!state->load(reader)) {
+            std::destroy_at(state);
+            return nullptr;
+          }
+        }
+
+        return state;
+      }
+
+    private:
+      std::vector<entry> m_entries;
+      std::unordered_map<std::type_index, state_id> m_ids;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class simple_machine
+   * @brief A simple FSM.
+   *
+   * The `Recorder` is notified of the transitions and updates, see
+   * `machine_stats`.
+   */
+  template <typename T, typename Recorder = no_recorder>
+  class simple_machine {
+    public:
+      simple_machine(transition_mode mode = transition_mode::immediate) : m_mode(mode) {}
+
+      /**
+       * @brief Enters in a new state, exiting the previous one (if any).
+       */
+      template <state_trait<T> S>
+      void set_state(S state, T& blackboard) {
+        emplace_state<S>(blackboard, std::move(state));
+      }
+
+      /**
+       * @brief Enters in a new state constructed in place from `args`,
+       * exiting the previous one (if any).
+       */
+      template <state_trait<T> S, typename... Args>
+      requires std::constructible_from<S, Args...>
+      void emplace_state(T& blackboard, Args&&... args) {
+        auto next_state = std::make_unique<S>(std::forward<Args>(args)...);
+
+        if (m_mode == transition_mode::deferred) {
+          m_pending_state = std::move(next_state);
+          m_has_pending = true;
+          return;
+        }
+
+        apply_state(std::move(next_state), blackboard);
+      }
+
+      /**
+       * @brief Clear the current state.
+       */
+      void clear_state(T& blackboard) {
+        if (m_mode == transition_mode::deferred) {
+          m_pending_state = nullptr;
+          m_has_pending = true;
+          return;
+        }
+
+        apply_state(nullptr, blackboard);
+      }
+
+      /**
+       * @brief Apply the transition recorded in deferred mode (if any).
+       *
+       * Only the last requested transition is applied. Returns `true` if a
+       * transition was applied.
+       */
+      bool commit(T& blackboard) {
+        if (!m_has_pending) {
+          return false;
+        }
+
+        m_has_pending = false;
+        apply_state(std::move(m_pending_state), blackboard);
+        return true;
+      }
+
+      /**
+       * @brief Check if a transition is waiting for `commit()`.
+       */
+      bool has_pending() const {
+        return m_has_pending;
+      }
+
+      /**
+       * @brief Pause the machine.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+
+        if (m_current_state) {
+          m_current_state->pause(blackboard);
+        }
+      }
+
+      /**
+       * @brief Resume the machine.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+
+        if (m_current_state) {
+          m_current_state->resume(blackboard);
+        }
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (m_paused) {
+          return;
+        }
+
+        if (m_current_state) {
+          if constexpr (Recorder::enabled) {
+            detail::recorded_update<T>(m_recorder, m_current_state.get(), blackboard);
+          }
+          else {
+            m_current_state->update(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Get the recorder of the machine.
+       */
+      const Recorder& recorder() const {
+        return m_recorder;
+      }
+
+      Recorder& recorder() {
+        return m_recorder;
+      }
+
+      /**
+       * @brief Write the current state and the paused flag.
+       *
+       * Returns `false`, without writing anything, if the current state is
+       * not registered.
+       */
+      bool save(snapshot_writer& writer, const state_registry<T>& registry) const {
+        auto paused = std::uint64_t{m_paused ? 1u : 0u};
+
+        if (!m_current_state) {
+          writer.write_varint(paused);
+          return true;
+        }
+
+        auto id = registry.id_of(*m_current_state);
+        if (id == no_state) {
+          return false;
+        }
+
+        // 0 stands for "no state", the lowest bit is the paused flag.
+        writer.write_varint(((id + 1) << 1) | paused);
+        registry.save_payload(id, *m_current_state, writer);
+        return true;
+      }
+
+      /**
+       * @brief Replace the current state and the paused flag with the ones
+       * written by `save()`.
+       *
+       * The `exit`/`enter` methods are not called, and pending transitions
+       * are dropped. Returns `false`, leaving the machine untouched, if the
+       * snapshot is invalid.
+       */
+      bool restore(snapshot_reader& reader, const state_registry<T>& registry) {
+        auto header = std::uint64_t{0};
+        if (!reader.read_varint(header)) {
+          return false;
+        }
+
+        auto next_state = state_ptr<T>{nullptr};
+        if ((header >> 1) != 0) {
+          next_state = registry.make(static_cast<state_id>((header >> 1) - 1), reader);
+
+          if (!next_state) {
+            return false;
+          }
+        }
+
+        m_current_state = std::move(next_state);
+        m_paused = (header & 1) != 0;
+        m_pending_state = nullptr;
+        m_has_pending = false;
+        return true;
+      }
+
+      /**
+       * @brief Get the current state, or `nullptr`.
+       */
+      state<T>* current_state() {
+        return m_current_state.get();
+      }
+
+      /**
+       * @brief Check if the machine is paused.
+       */
+      bool is_paused() const {
+        return m_paused;
+      }
+
+    private:
+      void apply_state(state_ptr<T> next_state, T& blackboard) {
+        if constexpr (Recorder::enabled) {
+          m_recorder.record_transition(
+            detail::state_type<T>(m_current_state.get()),
+            detail::state_type<T>(next_state.get())
+          );
+        }
+
+        if (m_current_state) {
+          m_current_state->exit(blackboard);
+        }
+
+        m_current_state = std::move(next_state);
+
+        if (m_current_state) {
+          m_current_state->enter(blackboard);
+
+          if (m_paused) {
+            m_current_state->pause(blackboard);
+          }
+        }
+      }
+
+    private:
+      state_ptr<T> m_current_state{nullptr};
+      bool m_paused{false};
+
+      transition_mode m_mode;
+      state_ptr<T> m_pending_state{nullptr};
+
+      [[no_unique_address]] Recorder m_recorder;
+      bool m_has_pending{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @class stack_machine
+   * @brief A stack FSM.
+   *
+   * With `N == 0`, the stack is unbounded and the states are allocated on the
+   * heap. Otherwise, up to `N` states of at most `StateSize` bytes are stored
+   * inline.
+   *
+   * The `Recorder` is notified when the top state changes and when it is
+   * updated, see `machine_stats`.
+   */
+  template <
+    typename T,
+    std::size_t N = 0,
+    std::size_t StateSize = 64,
+    typename Recorder = no_recorder
+  >
+  class stack_machine {
+    public:
+      stack_machine(transition_mode mode = transition_mode::immediate) : m_mode(mode) {}
+
+      /**
+       * @brief Enters in a new state, pausing the previous one (if any).
+      */
+      template <state_trait<T> S>
+      void push_state(S state, T& blackboard) {
+        emplace_state<S>(blackboard, std::move(state));
+      }
+
+      /**
+       * @brief Enters in a new state constructed in place from `args`,
+       * pausing the previous one (if any).
+       */
+      template <state_trait<T> S, typename... Args>
+      requires std::constructible_from<S, Args...>
+      void emplace_state(T& blackboard, Args&&... args) {
+        auto next_state = std::make_unique<S>(std::forward<Args>(args)...);
+
+        if (m_mode == transition_mode::deferred) {
+          m_pending.push_back(std::move(next_state));
+          return;
+        }
+
+        apply_push(std::move(next_state), blackboard);
+      }
+
+      /**
+       * @brief Exits the current state, resuming the previous one (if any).
+       */
+      void pop_state(T& blackboard) {
+        if (m_mode == transition_mode::deferred) {
+          m_pending.push_back(nullptr);
+          return;
+        }
+
+        apply_pop(blackboard);
+      }
+
+      /**
+       * @brief Apply the transitions recorded in deferred mode, in order.
+       *
+       * Transitions requested by the states while committing are kept for
+       * the next `commit()`. Returns the number of applied transitions.
+       */
+      std::size_t commit(T& blackboard) {
+        auto pending = std::exchange(m_pending, {});
+
+        for (auto& next_state : pending) {
+          if (next_state) {
+            apply_push(std::move(next_state), blackboard);
+          }
+          else {
+            apply_pop(blackboard);
+          }
+        }
+
+        return pending.size();
+      }
+
+      /**
+       * @brief Check if transitions are waiting for `commit()`.
+       */
+      bool has_pending() const {
+        return !m_pending.empty();
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (!m_state_stack.empty()) {
+          auto& current_state = m_state_stack.back();
+
+          if constexpr (Recorder::enabled) {
+            detail::recorded_update<T>(m_recorder, current_state.get(), blackboard);
+          }
+          else {
+            current_state->update(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Get the recorder of the machine.
+       */
+      const Recorder& recorder() const {
+        return m_recorder;
+      }
+
+      Recorder& recorder() {
+        return m_recorder;
+      }
+
+      /**
+       * @brief Write the states of the stack, from the bottom to the top.
+       *
+       * Returns `false`, without writing anything, if a state is not
+       * registered.
+       */
+      bool save(snapshot_writer& writer, const state_registry<T>& registry) const {
+        for (auto& state : m_state_stack) {
+          if (registry.id_of(*state) == no_state) {
+            return false;
+          }
+        }
+
+        writer.write_varint(m_state_stack.size());
+
+        for (auto& state : m_state_stack) {
+          auto id = registry.id_of(*state);
+          writer.write_varint(id);
+          registry.save_payload(id, *state, writer);
+        }
+
+        return true;
+      }
+
+      /**
+       * @brief Replace the states of the stack with the ones written by
+       * `save()`.
+       *
+       * The `exit`/`enter` methods are not called, and pending transitions
+       * are dropped. Returns `false`, leaving the machine untouched, if the
+       * snapshot is invalid.
+       */
+      bool restore(snapshot_reader& reader, const state_registry<T>& registry) {
+        auto count = std::uint64_t{0};
+        if (!reader.read_varint(count) || count > reader.remaining()) {
+          return false;
+        }
+
+        auto states = std::vector<state_ptr<T>>{};
+        states.reserve(count);
+
+        for (std::uint64_t i = 0; i < count; i++) {
+          auto id = std::uint64_t{0};
+          if (!reader.read_varint(id)) {
+            return false;
+          }
+
+          auto restored = registry.make(static_cast<state_id>(id), reader);
+          if (!restored) {
+            return false;
+          }
+
+          states.push_back(std::move(restored));
+        }
+
+        m_state_stack = std::move(states);
+        m_pending.clear();
+        return true;
+      }
+
+    private:
+      state<T>* top() const {
+        return m_state_stack.empty() ? nullptr : m_state_stack.back().get();
+      }
+
+      void apply_push(state_ptr<T> next_state, T& blackboard) {
+        if constexpr (Recorder::enabled) {
+          m_recorder.record_transition(
+            detail::state_type<T>(top()),
+            detail::state_type<T>(next_state.get())
+          );
+        }
+
+        if (!m_state_stack.empty()) {
+          auto& current_state = m_state_stack.back();
+          current_state->pause(blackboard);
+        }
+
+        m_state_stack.push_back(std::move(next_state));
+        m_state_stack.back()->enter(blackboard);
+      }
+
+      void apply_pop(T& blackboard) {
+        if (!m_state_stack.empty()) {
+          auto& current_state = m_state_stack.back();
+          current_state->exit(blackboard);
+
+          if constexpr (Recorder::enabled) {
+            auto from = detail::state_type<T>(current_state.get());
+            m_state_stack.pop_back();
+            m_recorder.record_transition(from, detail::state_type<T>(top()));
+          }
+          else {
+            m_state_stack.pop_back();
+          }
+        }
+
+        if (!m_state_stack.empty()) {
+          auto& current_state = m_state_stack.back();
+          current_state->resume(blackboard);
+        }
+      }
+
+    private:
+      std::vector<state_ptr<T>> m_state_stack;
+
+      transition_mode m_mode;
+      std::vector<state_ptr<T>> m_pending;
+
+      [[no_unique_address]] Recorder m_recorder;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class stack_machine
+   * @brief A stack FSM with a fixed capacity, storing its states inline.
+   */
+  template <typename T, std::size_t N, std::size_t StateSize, typename Recorder>
+  requires (N > 0)
+  class stack_machine<T, N, StateSize, Recorder> {
+    public:
+      stack_machine() = default;
+
+      stack_machine(const stack_machine&) = delete;
+      stack_machine& operator=(const stack_machine&) = delete;
+
+      ~stack_machine() {
+        while (m_size > 0) {
+          std::destroy_at(m_states[--m_size]);
+        }
+      }
+
+      /**
+       * @brief Enters in a new state, pausing the previous one (if any).
+       *
+       * Returns `false` if the stack is full.
+       */
+      template <state_trait<T> S>
+      bool push_state(S state, T& blackboard) {
+        return emplace_state<S>(blackboard, std::move(state));
+      }
+
+      /**
+       * @brief Enters in a new state constructed in place from `args`,
+       * pausing the previous one (if any).
+       *
+       * Returns `false` if the stack is full.
+       */
+      template <state_trait<T> S, typename... Args>
+      requires std::constructible_from<S, Args...>
+      bool emplace_state(T& blackboard, Args&&... args) {
+        static_assert(sizeof(S) <= StateSize, "state does not fit in a stack slot");
+        static_assert(alignof(S) <= alignof(slot), "state is over-aligned for a stack slot");
+
+        if (m_size == N) {
+          return false;
+        }
+
+        if constexpr (Recorder::enabled) {
+          m_recorder.record_transition(
+            detail::state_type<T>(top()),
+            std::type_index(typeid(S))
+          );
+        }
+
+        if (m_size > 0) {
+          m_states[m_size - 1]->pause(blackboard);
+        }
+
+        auto next_state = std::construct_at(
+          reinterpret_cast<S*>(m_slots[m_size].data),
+          std::forward<Args>(args)...
+        );
+        m_states[m_size++] = next_state;
+        next_state->enter(blackboard);
+        return true;
+      }
+
+      /**
+       * @brief Exits the current state, resuming the previous one (if any).
+       */
+      void pop_state(T& blackboard) {
+        if (m_size > 0) {
+          auto current_state = m_states[--m_size];
+          current_state->exit(blackboard);
+
+          if constexpr (Recorder::enabled) {
+            m_recorder.record_transition(
+              detail::state_type<T>(current_state),
+              detail::state_type<T>(top())
+            );
+          }
+
+          std::destroy_at(current_state);
+        }
+
+        if (m_size > 0) {
+          m_states[m_size - 1]->resume(blackboard);
+        }
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (m_size > 0) {
+          auto current_state = m_states[m_size - 1];
+
+          if constexpr (Recorder::enabled) {
+            detail::recorded_update<T>(m_recorder, current_state, blackboard);
+          }
+          else {
+            current_state->update(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Get the recorder of the machine.
+       */
+      const Recorder& recorder() const {
+        return m_recorder;
+      }
+
+      Recorder& recorder() {
+        return m_recorder;
+      }
+
+      /**
+       * @brief Number of states on the stack.
+       */
+      std::size_t size() const {
+        return m_size;
+      }
+
+      /**
+       * @brief Maximum number of states on the stack.
+       */
+      static constexpr std::size_t capacity() {
+        return N;
+      }
+
+      /**
+       * @brief Write the states of the stack, from the bottom to the top.
+       *
+       * Returns `false`, without writing anything, if a state is not
+       * registered.
+       */
+      bool save(snapshot_writer& writer, const state_registry<T>& registry) const {
+        for (std::size_t idx = 0; idx < m_size; idx++) {
+          if (registry.id_of(*m_states[idx]) == no_state) {
+            return false;
+          }
+        }
+
+        writer.write_varint(m_size);
+
+        for (std::size_t idx = 0; idx < m_size; idx++) {
+          auto id = registry.id_of(*m_states[idx]);
+          writer.write_varint(id);
+          registry.save_payload(id, *m_states[idx], writer);
+        }
+
+        return true;
+      }
+
+      /**
+       * @brief Replace the states of the stack with the ones written by
+       * `save()`.
+       *
+       * The `exit`/`enter` methods are not called. Returns `false`, leaving
+       * the machine untouched, if the snapshot is invalid or does not fit.
+       */
+      bool restore(snapshot_reader& reader, const state_registry<T>& registry) {
+        auto count = std::uint64_t{0};
+        if (!reader.read_varint(count) || count > N) {
+          return false;
+        }
+
+        // The states are decoded twice: first into a scratch slot, to
+        // validate the snapshot before the current states are destroyed.
+        auto validator = reader;
+        auto scratch = slot{};
+
+        for (std::uint64_t i = 0; i < count; i++) {
+          auto restored = construct_state(validator, registry, scratch);
+          if (restored == nullptr) {
+            return false;
+          }
+
+          std::destroy_at(restored);
+        }
+
+        while (m_size > 0) {
+          std::destroy_at(m_states[--m_size]);
+        }
+
+        for (std::uint64_t i = 0; i < count; i++) {
+          m_states[m_size] = construct_state(reader, registry, m_slots[m_size]);
+          m_size++;
+        }
+
+        return true;
+      }
+
+    private:
+      struct slot {
+        alignas(std::max_align_t) std::byte data[StateSize];
+      };
+
+      state<T>* top() const {
+        return m_size > 0 ? m_states[m_size - 1] : nullptr;
+      }
+
+      static state<T>* construct_state(
+        snapshot_reader& reader,
+        const state_registry<T>& registry,
+        slot& storage
+      ) {
+        auto id = std::uint64_t{0};
+        if (!reader.read_varint(id)) {
+          return nullptr;
+        }
+
+        return registry.construct(
+          static_cast<state_id>(id),
+          reader,
+          storage.data,
+          StateSize,
+          alignof(slot)
+        );
+      }
+
+    private:
+      std::array<slot, N> m_slots;
+      std::array<state<T>*, N> m_states{};
+      std::size_t m_size{0};
+
+      [[no_unique_address]] Recorder m_recorder;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class orthogonal_machine
+   * @brief A FSM with several concurrent regions, each one having its own
+   * current state.
+   *
+   * The states of the regions are stored inline, in slots of at most
+   * `StateSize` bytes, and updated in region order.
+   */
+  template <typename T, std::size_t Regions, std::size_t StateSize = 64>
+  requires (Regions > 0)
+  class orthogonal_machine {
+    public:
+      /**
+       * @brief Number of regions.
+       */
+      static constexpr std::size_t region_count = Regions;
+
+      orthogonal_machine() = default;
+
+      orthogonal_machine(const orthogonal_machine&) = delete;
+      orthogonal_machine& operator=(const orthogonal_machine&) = delete;
+
+      ~orthogonal_machine() {
+        for (auto state : m_states) {
+          if (state != nullptr) {
+            std::destroy_at(state);
+          }
+        }
+      }
+
+      /**
+       * @brief Enters a region in a new state, exiting its previous one (if
+       * any).
+       *
+       * Returns `false` if the region does not exist.
+       */
+      template <state_trait<T> S>
+      bool set_state(std::size_t region, S state, T& blackboard) {
+        return emplace_state<S>(region, blackboard, std::move(state));
+      }
+
+      /**
+       * @brief Enters a region in a new state constructed in place from
+       * `args`, exiting its previous one (if any).
+       *
+       * Returns `false` if the region does not exist.
+       */
+      template <state_trait<T> S, typename... Args>
+      requires std::constructible_from<S, Args...>
+      bool emplace_state(std::size_t region, T& blackboard, Args&&... args) {
+        static_assert(sizeof(S) <= StateSize, "state does not fit in a region slot");
+        static_assert(alignof(S) <= alignof(slot), "state is over-aligned for a region slot");
+
+        if (region >= Regions) {
+          return false;
+        }
+
+        exit_region(region, blackboard);
+
+        auto next_state = std::construct_at(
+          reinterpret_cast<S*>(m_slots[region].data),
+          std::forward<Args>(args)...
+        );
+        m_states[region] = next_state;
+        next_state->enter(blackboard);
+
+        if (m_paused) {
+          next_state->pause(blackboard);
+        }
+
+        return true;
+      }
+
+      /**
+       * @brief Clear the current state of a region.
+       */
+      void clear_state(std::size_t region, T& blackboard) {
+        if (region < Regions) {
+          exit_region(region, blackboard);
+        }
+      }
+
+      /**
+       * @brief Clear the current state of every region.
+       */
+      void clear_state(T& blackboard) {
+        for (std::size_t region = 0; region < Regions; region++) {
+          exit_region(region, blackboard);
+        }
+      }
+
+      /**
+       * @brief Check if a region has a current state.
+       */
+      bool has_state(std::size_t region) const {
+        return region < Regions && m_states[region] != nullptr;
+      }
+
+      /**
+       * @brief Pause every region.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+
+        for (auto state : m_states) {
+          if (state != nullptr) {
+            state->pause(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Resume every region.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+
+        for (auto state : m_states) {
+          if (state != nullptr) {
+            state->resume(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Update every region, in order.
+       */
+      void update(T& blackboard) {
+        if (m_paused) {
+          return;
+        }
+
+        for (std::size_t region = 0; region < Regions; region++) {
+          if (m_states[region] != nullptr) {
+            m_states[region]->update(blackboard);
+          }
+        }
+      }
+
+    private:
+      struct slot {
+        alignas(std::max_align_t) std::byte data[StateSize];
+      };
+
+      void exit_region(std::size_t region, T& blackboard) {
+        auto current_state = std::exchange(m_states[region], nullptr);
+
+        if (current_state != nullptr) {
+          current_state->exit(blackboard);
+          std::destroy_at(current_state);
+        }
+      }
+
+    private:
+      std::array<state<T>*, Regions> m_states{};
+      std::array<slot, Regions> m_slots;
+      bool m_paused{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Get the instance of a state type shared by the whole program.
+   */
+  template <typename S>
+  requires std::default_initializable<S>
+  S& shared_state() {
+    static S instance{};
+    return instance;
+  }
+
+  /**
+   * @ingroup fsm
+   * @class flyweight_machine
+   * @brief A simple FSM whose states are shared by many machines.
+   *
+   * The machine only points to its current state, which it does not own.
+   */
+  template <typename T>
+  class flyweight_machine {
+    public:
+      /**
+       * @brief Enters in a shared state, exiting the previous one (if any).
+       *
+       * The state must outlive the machine, or the transition to the next
+       * state.
+       */
+      void set_state(state<T>& shared, T& blackboard) {
+        if (m_current_state != nullptr) {
+          m_current_state->exit(blackboard);
+        }
+
+        m_current_state = &shared;
+        m_current_state->enter(blackboard);
+
+        if (m_paused) {
+          m_current_state->pause(blackboard);
+        }
+      }
+
+      /**
+       * @brief Enters in the instance of `S` returned by `shared_state()`,
+       * exiting the previous state (if any).
+       */
+      template <state_trait<T> S>
+      requires std::default_initializable<S>
+      void set_state(T& blackboard) {
+        set_state(shared_state<S>(), blackboard);
+      }
+
+      /**
+       * @brief Clear the current state.
+       */
+      void clear_state(T& blackboard) {
+        if (m_current_state != nullptr) {
+          m_current_state->exit(blackboard);
+          m_current_state = nullptr;
+        }
+      }
+
+      /**
+       * @brief Check if the current state is of type `S`.
+       */
+      template <state_trait<T> S>
+      bool is_in_state() const {
+        return m_current_state != nullptr && typeid(*m_current_state) == typeid(S);
+      }
+
+      /**
+       * @brief Pause the machine.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+
+        if (m_current_state != nullptr) {
+          m_current_state->pause(blackboard);
+        }
+      }
+
+      /**
+       * @brief Resume the machine.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+
+        if (m_current_state != nullptr) {
+          m_current_state->resume(blackboard);
+        }
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (m_paused) {
+          return;
+        }
+
+        if (m_current_state != nullptr) {
+          m_current_state->update(blackboard);
+        }
+      }
+
+    private:
+      state<T>* m_current_state{nullptr};
+      bool m_paused{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @class static_machine
+   * @brief A simple FSM, whose possible states are known at compile time.
+   *
+   * The current state is stored inline in a `std::variant`, so transitions
+   * do not allocate.
+   */
+  template <typename T, state_trait<T>... States>
+  class static_machine {
+    public:
+      /**
+       * @brief Enters in a new state, exiting the previous one (if any).
+       */
+      template <state_trait<T> S>
+      requires (std::same_as<S, States> || ...)
+      void set_state(S state, T& blackboard) {
+        emplace_state<S>(blackboard, std::move(state));
+      }
+
+      /**
+       * @brief Enters in a new state constructed in place from `args`,
+       * exiting the previous one (if any).
+       */
+      template <state_trait<T> S, typename... Args>
+      requires (std::same_as<S, States> || ...) && std::constructible_from<S, Args...>
+      void emplace_state(T& blackboard, Args&&... args) {
+        dispatch([&]<typename C>(C& current) { current.C::exit(blackboard); });
+
+        auto& current = m_current_state.template emplace<S>(std::forward<Args>(args)...);
+        current.S::enter(blackboard);
+
+        if (m_paused) {
+          current.S::pause(blackboard);
+        }
+      }
+
+      /**
+       * @brief Clear the current state.
+       */
+      void clear_state(T& blackboard) {
+        dispatch([&]<typename C>(C& current) { current.C::exit(blackboard); });
+        m_current_state.template emplace<std::monostate>();
+      }
+
+      /**
+       * @brief Pause the machine.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+        dispatch([&]<typename C>(C& current) { current.C::pause(blackboard); });
+      }
+
+      /**
+       * @brief Resume the machine.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+        dispatch([&]<typename C>(C& current) { current.C::resume(blackboard); });
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (m_paused) {
+          return;
+        }
+
+        dispatch([&]<typename C>(C& current) { current.C::update(blackboard); });
+      }
+
+    private:
+      template <typename F>
+      void dispatch(F&& fn) {
+        std::visit(
+          [&](auto& current) {
+            using S = std::remove_cvref_t<decltype(current)>;
+
+            if constexpr (!std::same_as<S, std::monostate>) {
+              fn(current);
+            }
+          },
+          m_current_state
+        );
+      }
+
+    private:
+      std::variant<std::monostate, States...> m_current_state;
+      bool m_paused{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Tag type standing for the enumerator `S`, used to overload the
+   * handlers of an `enum_machine`.
+   */
+  template <auto S>
+  using state_tag = std::integral_constant<decltype(S), S>;
+
+  /**
+   * @ingroup fsm
+   * @brief Allowed transition of an `enum_machine`.
+   */
+  template <typename Enum>
+  requires std::is_enum_v<Enum>
+  struct enum_transition {
+    Enum from;
+    Enum to;
+  };
+
+  template <typename Enum>
+  enum_transition(Enum, Enum) -> enum_transition<Enum>;
+
+  /**
+   * @ingroup fsm
+   * @class enum_machine
+   * @brief A FSM whose states are the enumerators `0` to `state_count - 1`
+   * of an enum, with a transition table known at compile time.
+   *
+   * `Traits` provides:
+   *  - `state`: the enum type
+   *  - `state_count`: the number of states
+   *  - `transitions`: a constexpr range of `enum_transition<state>`
+   *  - optionally, static `enter`, `exit` and `update` functions taking a
+   *    `state_tag<S>` and the blackboard, for each state `S`
+   *
+   * The handlers are dispatched without any virtual call, and the table is
+   * validated at compile time.
+   */
+  template <typename T, typename Traits>
+  class enum_machine {
+    public:
+      using state_type = typename Traits::state;
+
+      static constexpr std::size_t state_count = Traits::state_count;
+
+    private:
+      static consteval bool table_in_range() {
+        for (auto& t : Traits::transitions) {
+          if (static_cast<std::size_t>(t.from) >= state_count) {
+            return false;
+          }
+
+          if (static_cast<std::size_t>(t.to) >= state_count) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      static consteval bool table_unique() {
+        auto first = std::begin(Traits::transitions);
+        auto last = std::end(Traits::transitions);
+
+        for (auto it = first; it != last; ++it) {
+          for (auto other = std::next(it); other != last; ++other) {
+            if (it->from == other->from && it->to == other->to) {
+              return false;
+            }
+          }
+        }
+
+        return true;
+      }
+
+      static_assert(std::is_enum_v<state_type>, "Traits::state must be an enum");
+      static_assert(state_count > 0, "Traits::state_count must not be 0");
+      static_assert(table_in_range(), "transition table refers to an unknown state");
+      static_assert(table_unique(), "transition table has duplicate transitions");
+
+      static constexpr auto allowed = []() {
+        auto table = std::array<std::array<bool, state_count>, state_count>{};
+
+        for (auto& t : Traits::transitions) {
+          table[static_cast<std::size_t>(t.from)][static_cast<std::size_t>(t.to)] = true;
+        }
+
+        return table;
+      }();
+
+    public:
+      /**
+       * @brief Check if the table has a transition from `From` to `To`.
+       */
+      template <state_type From, state_type To>
+      static constexpr bool has_transition() {
+        return allowed[static_cast<std::size_t>(From)][static_cast<std::size_t>(To)];
+      }
+
+      /**
+       * @brief Check if the table has a transition to `To`, from any state.
+       */
+      template <state_type To>
+      static constexpr bool is_reachable() {
+        for (auto& row : allowed) {
+          if (row[static_cast<std::size_t>(To)]) {
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      /**
+       * @brief Enters in a state without checking the transition table, used
+       * to start the machine.
+       */
+      template <state_type S>
+      requires (static_cast<std::size_t>(S) < state_count)
+      void set_state(T& blackboard) {
+        if (m_current != no_state) {
+          dispatch_exit(blackboard);
+        }
+
+        m_current = static_cast<std::size_t>(S);
+        call_enter(state_tag<S>{}, blackboard);
+      }
+
+      /**
+       * @brief Enters in a state if the table has a transition from the
+       * current state, returns `false` otherwise.
+       *
+       * Transitioning to a state without any incoming transition fails to
+       * compile.
+       */
+      template <state_type To>
+      requires (static_cast<std::size_t>(To) < state_count)
+      bool transition_to(T& blackboard) {
+        static_assert(is_reachable<To>(), "no transition leads to this state");
+
+        if (m_current == no_state || !allowed[m_current][static_cast<std::size_t>(To)]) {
+          return false;
+        }
+
+        dispatch_exit(blackboard);
+        m_current = static_cast<std::size_t>(To);
+        call_enter(state_tag<To>{}, blackboard);
+        return true;
+      }
+
+      /**
+       * @brief Check if the table has a transition from the current state.
+       */
+      bool can_transition_to(state_type to) const {
+        auto idx = static_cast<std::size_t>(to);
+        return m_current != no_state && idx < state_count && allowed[m_current][idx];
+      }
+
+      /**
+       * @brief Check if the machine has a current state.
+       */
+      bool has_state() const {
+        return m_current != no_state;
+      }
+
+      /**
+       * @brief Get the current state, only valid if `has_state()`.
+       */
+      state_type current_state() const {
+        return static_cast<state_type>(m_current);
+      }
+
+      /**
+       * @brief Exit the current state (if any).
+       */
+      void clear_state(T& blackboard) {
+        if (m_current != no_state) {
+          dispatch_exit(blackboard);
+          m_current = no_state;
+        }
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        dispatch([&](auto tag) {
+          if constexpr (requires { Traits::update(tag, blackboard); }) {
+            Traits::update(tag, blackboard);
+          }
+        });
+      }
+
+    private:
+      // Expands to a chain of comparisons against constants, which compilers
+      // lower to a switch.
+      template <typename F>
+      void dispatch(F&& fn) const {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+          (void)((m_current == I ? (fn(state_tag<static_cast<state_type>(I)>{}), true) : false) || ...);
+        }(std::make_index_sequence<state_count>{});
+      }
+
+      template <state_type S>
+      static void call_enter(state_tag<S> tag, T& blackboard) {
+        if constexpr (requires { Traits::enter(tag, blackboard); }) {
+          Traits::enter(tag, blackboard);
+        }
+      }
+
+      void dispatch_exit(T& blackboard) {
+        dispatch([&](auto tag) {
+          if constexpr (requires { Traits::exit(tag, blackboard); }) {
+            Traits::exit(tag, blackboard);
+          }
+        });
+      }
+
+    private:
+      std::size_t m_current{no_state};
+  };
+
+  /**
+   * @ingroup fsm
+   * @class indexed_machine
+   * @brief A simple FSM, whose states are registered once and reused.
+   *
+   * The states are stored contiguously in the machine, and identified by
+   * their position in `States`. Transitions do not create nor destroy any
+   * state object.
+   */
+  template <typename T, state_trait<T>... States>
+  class indexed_machine {
+    public:
+      /**
+       * @brief Number of registered states.
+       */
+      static constexpr std::size_t state_count = sizeof...(States);
+
+      indexed_machine() = default;
+      indexed_machine(States... states) : m_states(std::move(states)...) {}
+
+      /**
+       * @brief Get the identifier of a registered state type.
+       */
+      template <state_trait<T> S>
+      static constexpr state_id id_of() {
+        return detail::index_of<S, States...>();
+      }
+
+      /**
+       * @brief Enters in a registered state, exiting the previous one (if any).
+       *
+       * Returns `false` if the identifier is unknown.
+       */
+      bool transition_to(state_id id, T& blackboard) {
+        if (id >= state_count) {
+          return false;
+        }
+
+        if (m_current_id != no_state) {
+          get(m_current_id).exit(blackboard);
+        }
+
+        m_current_id = id;
+
+        auto& current_state = get(m_current_id);
+        current_state.enter(blackboard);
+
+        if (m_paused) {
+          current_state.pause(blackboard);
+        }
+
+        return true;
+      }
+
+      /**
+       * @brief Enters in a registered state, exiting the previous one (if any).
+       */
+      template <state_trait<T> S>
+      requires (std::same_as<S, States> || ...)
+      void transition_to(T& blackboard) {
+        transition_to(id_of<S>(), blackboard);
+      }
+
+      /**
+       * @brief Get the identifier of the current state, or `no_state`.
+       */
+      state_id current_state() const {
+        return m_current_id;
+      }
+
+      /**
+       * @brief Get a registered state.
+       */
+      template <state_trait<T> S>
+      requires (std::same_as<S, States> || ...)
+      S& get_state() {
+        return std::get<id_of<S>()>(m_states);
+      }
+
+      /**
+       * @brief Clear the current state.
+       */
+      void clear_state(T& blackboard) {
+        if (m_current_id != no_state) {
+          get(m_current_id).exit(blackboard);
+          m_current_id = no_state;
+        }
+      }
+
+      /**
+       * @brief Pause the machine.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+
+        if (m_current_id != no_state) {
+          get(m_current_id).pause(blackboard);
+        }
+      }
+
+      /**
+       * @brief Resume the machine.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+
+        if (m_current_id != no_state) {
+          get(m_current_id).resume(blackboard);
+        }
+      }
+
+      /**
+       * @brief Update the machine.
+       */
+      void update(T& blackboard) {
+        if (m_paused) {
+          return;
+        }
+
+        if (m_current_id != no_state) {
+          get(m_current_id).update(blackboard);
+        }
+      }
+
+    private:
+      using storage_type = std::tuple<States...>;
+      using accessor_type = state<T>& (*)(storage_type&);
+
+      static constexpr auto accessors = []<std::size_t... I>(std::index_sequence<I...>) {
+        return std::array<accessor_type, state_count>{
+          +[](storage_type& states) -> state<T>& { return std::get<I>(states); }...
+        };
+      }(std::index_sequence_for<States...>{});
+
+      state<T>& get(state_id id) {
+        return accessors[id](m_states);
+      }
+
+    private:
+      storage_type m_states;
+      state_id m_current_id{no_state};
+      bool m_paused{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier of an event.
+   */
+  using event_id = std::size_t;
+
+  /**
+   * @ingroup fsm
+   * @class event_queue
+   * @brief A bounded, lock-free, multi-producer single-consumer queue.
+   *
+   * Each cell carries a sequence number telling whether it is ready to be
+   * written or read, so producers only contend on one atomic counter and
+   * never block each other.
+   */
+  template <std::move_constructible E>
+  class event_queue {
+    public:
+      /**
+       * @brief Create a queue, its capacity is rounded up to a power of 2.
+       */
+      explicit event_queue(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+          size <<= 1;
+        }
+
+        m_mask = size - 1;
+        m_cells = std::make_unique<cell[]>(size);
+
+        for (std::size_t idx = 0; idx < size; idx++) {
+          m_cells[idx].sequence.store(idx, std::memory_order_relaxed);
+        }
+      }
+
+      event_queue(const event_queue&) = delete;
+      event_queue& operator=(const event_queue&) = delete;
+
+      ~event_queue() {
+        while (try_pop()) {}
+      }
+
+      /**
+       * @brief Maximum number of events in the queue.
+       */
+      std::size_t capacity() const {
+        return m_mask + 1;
+      }
+
+      /**
+       * @brief Push an event, can be called from any thread.
+       *
+       * Returns `false` if the queue is full.
+       */
+      bool try_push(E event) {
+        auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        cell* target = nullptr;
+
+        while (true) {
+          target = &m_cells[pos & m_mask];
+          auto sequence = target->sequence.load(std::memory_order_acquire);
+          auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+          if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              break;
+            }
+          }
+          else if (diff < 0) {
+            return false;
+          }
+          else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+          }
+        }
+
+        std::construct_at(target->value(), std::move(event));
+        target->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+
+      /**
+       * @brief Pop an event, must only be called from the consumer thread.
+       *
+       * Returns `std::nullopt` if the queue is empty.
+       */
+      std::optional<E> try_pop() {
+        auto& source = m_cells[m_dequeue_pos & m_mask];
+        auto sequence = source.sequence.load(std::memory_order_acquire);
+
+        if (sequence != m_dequeue_pos + 1) {
+          return std::nullopt;
+        }
+
+        auto event = std::optional<E>{std::move(*source.value())};
+        std::destroy_at(source.value());
+
+        source.sequence.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+        m_dequeue_pos++;
+        return event;
+      }
+
+      /**
+       * @brief Pop the events in the queue and pass them to `fn`, must only
+       * be called from the consumer thread.
+       *
+       * At most `capacity()` events are popped, so that producers cannot keep
+       * the consumer busy forever. Returns the number of popped events.
+       */
+      template <typename F>
+      std::size_t drain(F&& fn) {
+        std::size_t count = 0;
+
+        while (count < capacity()) {
+          auto event = try_pop();
+          if (!event) {
+            break;
+          }
+
+          fn(std::move(*event));
+          count++;
+        }
+
+        return count;
+      }
+
+    private:
+      struct cell {
+        std::atomic<std::size_t> sequence;
+        alignas(E) std::byte storage[sizeof(E)];
+
+        E* value() {
+          return std::launder(reinterpret_cast<E*>(storage));
+        }
+      };
+
+    private:
+      std::unique_ptr<cell[]> m_cells;
+      std::size_t m_mask{0};
+
+      alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+      alignas(64) std::size_t m_dequeue_pos{0};
+  };
+
+  /**
+   * @ingroup fsm
+   * @struct transition
+   * @brief A transition of an event machine: when `event` is dispatched in
+   * the `from` state, execute the `action` (if any) and enter the `to` state.
+   */
+  template <typename T, typename S = state_id, typename E = event_id>
+  struct transition {
+    S from;
+    E event;
+    S to;
+    void (*action)(T& blackboard) = nullptr;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class event_machine
+   * @brief A FSM whose transitions are triggered by events.
+   *
+   * The transitions are compiled into a dense `(state, event)` table on
+   * construction. If several transitions are declared for the same pair, the
+   * last one is kept. Transitions with an unknown state or event are ignored.
+   */
+  template <typename T, typename S = state_id, typename E = event_id>
+  class event_machine {
+    public:
+      event_machine(
+        S state_count,
+        E event_count,
+        const std::vector<transition<T, S, E>>& transitions,
+        S initial_state
+      ) : m_state_count(static_cast<std::size_t>(state_count)),
+          m_event_count(static_cast<std::size_t>(event_count)),
+          m_table(m_state_count * m_event_count)
+      {
+        for (auto& t : transitions) {
+          auto from = static_cast<std::size_t>(t.from);
+          auto event = static_cast<std::size_t>(t.event);
+          auto to = static_cast<std::size_t>(t.to);
+
+          if (from < m_state_count && event < m_event_count && to < m_state_count) {
+            m_table[from * m_event_count + event] = table_entry{
+              .to = to,
+              .action = t.action
+            };
+          }
+        }
+
+        set_state(initial_state);
+      }
+
+      /**
+       * @brief Dispatch an event.
+       *
+       * Returns `false` if the current state has no transition for it.
+       */
+      bool dispatch(E event, T& blackboard) {
+        auto idx = static_cast<std::size_t>(event);
+        if (m_current_state == no_state || idx >= m_event_count) {
+          return false;
+        }
+
+        auto& entry = m_table[m_current_state * m_event_count + idx];
+        if (entry.to == no_state) {
+          return false;
+        }
+
+        if (entry.action != nullptr) {
+          entry.action(blackboard);
+        }
+
+        m_current_state = entry.to;
+        return true;
+      }
+
+      /**
+       * @brief Dispatch the events posted to a queue, in order.
+       *
+       * Returns the number of events popped from the queue.
+       */
+      std::size_t dispatch_queued(event_queue<E>& queue, T& blackboard) {
+        return queue.drain([&](E event) {
+          dispatch(event, blackboard);
+        });
+      }
+
+      /**
+       * @brief Get the current state.
+       */
+      S current_state() const {
+        return static_cast<S>(m_current_state);
+      }
+
+      /**
+       * @brief Check if the machine has a valid current state.
+       */
+      bool has_state() const {
+        return m_current_state != no_state;
+      }
+
+      /**
+       * @brief Force the current state, without executing any action.
+       */
+      void set_state(S state) {
+        auto idx = static_cast<std::size_t>(state);
+        m_current_state = idx < m_state_count ? idx : no_state;
+      }
+
+    private:
+      struct table_entry {
+        state_id to{no_state};
+        void (*action)(T& blackboard){nullptr};
+      };
+
+    private:
+      std::size_t m_state_count;
+      std::size_t m_event_count;
+      std::vector<table_entry> m_table;
+      state_id m_current_state{no_state};
+  };
+
+  /**
+   * @ingroup fsm
+   * @class hierarchical_machine
+   * @brief A FSM whose states can be nested in composite states.
+   *
+   * The exit and entry sequences between every pair of states are derived
+   * from tables computed by `build()`: the chain of ancestors of each state,
+   * and the depth of the least common ancestor of each pair.
+   */
+  template <typename T>
+  class hierarchical_machine {
+    public:
+      /**
+       * @brief Register a state, returns its identifier.
+       *
+       * Returns `no_state` if the parent is unknown.
+       */
+      template <state_trait<T> S>
+      state_id add_state(S state, state_id parent = no_state) {
+        if (parent != no_state && parent >= m_states.size()) {
+          return no_state;
+        }
+
+        m_states.push_back(std::make_unique<S>(std::move(state)));
+        m_parents.push_back(parent);
+        m_initials.push_back(no_state);
+        m_built = false;
+
+        return m_states.size() - 1;
+      }
+
+      /**
+       * @brief Set the substate entered when transitioning to a composite
+       * state.
+       *
+       * Returns `false` if `child` is not a direct substate of `composite`.
+       */
+      bool set_initial_state(state_id composite, state_id child) {
+        auto count = m_states.size();
+        if (composite >= count || child >= count || m_parents[child] != composite) {
+          return false;
+        }
+
+        m_initials[composite] = child;
+        m_built = false;
+        return true;
+      }
+
+      /**
+       * @brief Precompute the transition tables.
+       */
+      void build() {
+        auto count = m_states.size();
+
+        m_chain_offsets.assign(count + 1, 0);
+        m_chains.clear();
+
+        for (state_id id = 0; id < count; id++) {
+          m_chain_offsets[id] = static_cast<std::uint32_t>(m_chains.size());
+
+          auto first = m_chains.size();
+          for (auto ancestor = id; ancestor != no_state; ancestor = m_parents[ancestor]) {
+            m_chains.push_back(static_cast<std::uint32_t>(ancestor));
+          }
+
+          std::reverse(m_chains.begin() + first, m_chains.end());
+        }
+        m_chain_offsets[count] = static_cast<std::uint32_t>(m_chains.size());
+
+        m_resolved.resize(count);
+        for (state_id id = 0; id < count; id++) {
+          auto leaf = id;
+          while (m_initials[leaf] != no_state) {
+            leaf = m_initials[leaf];
+          }
+
+          m_resolved[id] = static_cast<std::uint32_t>(leaf);
+        }
+
+        m_common_depths.resize(count * count);
+        for (state_id from = 0; from < count; from++) {
+          for (state_id to = 0; to < count; to++) {
+            auto from_chain = chain(from);
+            auto to_chain = chain(m_resolved[to]);
+
+            std::size_t common = 0;
+            while (
+              common < from_chain.size &&
+              common < to_chain.size &&
+              from_chain.data[common] == to_chain.data[common]
+            ) {
+              common++;
+            }
+
+            // The target itself is always exited and entered again.
+            common = std::min(common, chain(to).size - 1);
+            m_common_depths[from * count + to] = static_cast<std::uint16_t>(common);
+          }
+        }
+
+        m_built = true;
+      }
+
+      /**
+       * @brief Enters in a state, exiting the active states that are not its
+       * ancestors.
+       *
+       * Returns `false` if the state is unknown.
+       */
+      bool transition_to(state_id target, T& blackboard) {
+        if (target >= m_states.size()) {
+          return false;
+        }
+
+        if (!m_built) {
+          build();
+        }
+
+        std::size_t common = 0;
+
+        if (m_current_state != no_state) {
+          auto from_chain = chain(m_current_state);
+          common = m_common_depths[m_current_state * m_states.size() + target];
+
+          for (auto idx = from_chain.size; idx > common; idx--) {
+            m_states[from_chain.data[idx - 1]]->exit(blackboard);
+          }
+        }
+
+        m_current_state = m_resolved[target];
+
+        auto to_chain = chain(m_current_state);
+        for (auto idx = common; idx < to_chain.size; idx++) {
+          auto& entered = m_states[to_chain.data[idx]];
+          entered->enter(blackboard);
+
+          if (m_paused) {
+            entered->pause(blackboard);
+          }
+        }
+
+        return true;
+      }
+
+      /**
+       * @brief Get the innermost active state, or `no_state`.
+       */
+      state_id current_state() const {
+        return m_current_state;
+      }
+
+      /**
+       * @brief Check if a state is active, either as the innermost active
+       * state or one of its ancestors.
+       */
+      bool is_in_state(state_id id) const {
+        if (m_current_state == no_state || !m_built) {
+          return false;
+        }
+
+        auto active = chain(m_current_state);
+        for (std::size_t idx = 0; idx < active.size; idx++) {
+          if (active.data[idx] == id) {
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      /**
+       * @brief Exit all the active states.
+       */
+      void clear_state(T& blackboard) {
+        if (m_current_state != no_state) {
+          auto active = chain(m_current_state);
+          for (auto idx = active.size; idx > 0; idx--) {
+            m_states[active.data[idx - 1]]->exit(blackboard);
+          }
+
+          m_current_state = no_state;
+        }
+      }
+
+      /**
+       * @brief Pause the machine, from the innermost active state.
+       */
+      void pause(T& blackboard) {
+        m_paused = true;
+
+        if (m_current_state != no_state) {
+          auto active = chain(m_current_state);
+          for (auto idx = active.size; idx > 0; idx--) {
+            m_states[active.data[idx - 1]]->pause(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Resume the machine, from the outermost active state.
+       */
+      void resume(T& blackboard) {
+        m_paused = false;
+
+        if (m_current_state != no_state) {
+          auto active = chain(m_current_state);
+          for (std::size_t idx = 0; idx < active.size; idx++) {
+            m_states[active.data[idx]]->resume(blackboard);
+          }
+        }
+      }
+
+      /**
+       * @brief Update the active states, from the outermost one.
+       */
+      void update(T& blackboard) {
+        if (m_paused || m_current_state == no_state) {
+          return;
+        }
+
+        auto active = chain(m_current_state);
+        for (std::size_t idx = 0; idx < active.size; idx++) {
+          m_states[active.data[idx]]->update(blackboard);
+        }
+      }
+
+    private:
+      struct chain_view {
+        const std::uint32_t* data;
+        std::size_t size;
+      };
+
+      chain_view chain(state_id id) const {
+        return chain_view{
+          .data = m_chains.data() + m_chain_offsets[id],
+          .size = m_chain_offsets[id + 1] - m_chain_offsets[id]
+        };
+      }
+
+    private:
+      std::vector<state_ptr<T>> m_states;
+      std::vector<state_id> m_parents;
+      std::vector<state_id> m_initials;
+
+      std::vector<std::uint32_t> m_chains;
+      std::vector<std::uint32_t> m_chain_offsets;
+      std::vector<std::uint32_t> m_resolved;
+      std::vector<std::uint16_t> m_common_depths;
+      bool m_built{false};
+
+      state_id m_current_state{no_state};
+      bool m_paused{false};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier of a machine in a pool.
+   */
+  using machine_id = std::size_t;
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier standing for "no machine".
+   */
+  inline constexpr machine_id no_machine = static_cast<machine_id>(-1);
+
+  /**
+   * @ingroup fsm
+   * @brief Identifier of a group of machines in a pool.
+   */
+  using group_id = std::size_t;
+
+  /**
+   * @ingroup fsm
+   * @brief A state handling events of type `E`.
+   */
+  template <typename S, typename T, typename E>
+  concept event_handler = requires(S& state, const E& event, T& blackboard) {
+    state.on_event(event, blackboard);
+  };
+
+  /**
+   * @ingroup fsm
+   * @class machine_pool
+   * @brief Many simple FSMs, whose possible states are known at compile time,
+   * updated grouped by state.
+   *
+   * Each state type has its own dense array of state objects, with the
+   * identifiers of the machines they belong to. Each array is partitioned by
+   * group, so that the machines of a paused group are skipped as a whole.
+   */
+  template <typename T, state_trait<T>... States>
+  class machine_pool {
+    static_assert(
+      (std::move_constructible<States> && ...),
+      "the states of a machine_pool are moved, they must be move constructible"
+    );
+
+    public:
+      /**
+       * @brief Number of possible states.
+       */
+      static constexpr std::size_t state_count = sizeof...(States);
+
+      /**
+       * @brief Maximum number of groups, group identifiers must be lower.
+       */
+      static constexpr std::size_t max_group_count = 4096;
+
+      /**
+       * @brief Request to enter a machine in a new state, or to clear its
+       * state with `std::monostate`.
+       */
+      struct transition_request {
+        machine_id id{0};
+        std::variant<std::monostate, States...> target;
+      };
+
+      /**
+       * @brief Transition recorded in the history of a machine, `no_state`
+       * stands for "no state".
+       */
+      struct history_entry {
+        tick_type tick{0};
+        state_id from{no_state};
+        state_id to{no_state};
+      };
+
+      /**
+       * @brief Get the identifier of a possible state type.
+       */
+      template <state_trait<T> S>
+      static constexpr state_id id_of() {
+        return detail::index_of<S, States...>();
+      }
+
+      /**
+       * @brief Add a machine without any state to a group (created if
+       * needed), returns its identifier.
+       *
+       * The slots of removed machines are reused, with a new identifier.
+       * Returns `no_machine` if `group` is not lower than `max_group_count`.
+       */
+      machine_id add_machine(T blackboard, group_id group = 0) {
+        if (group >= max_group_count) {
+          return no_machine;
+        }
+
+        if (group >= m_groups.size()) {
+          m_groups.resize(group + 1);
+
+          for_each_state([&]<std::size_t I>() {
+            auto& bucket = std::get<I>(m_buckets);
+            bucket.group_ends.resize(m_groups.size(), bucket.states.size());
+          });
+        }
+
+        if (!m_free_slots.empty()) {
+          auto machine = m_free_slots.back();
+          m_free_slots.pop_back();
+
+          auto& s = m_slots[machine];
+          m_blackboards[machine] = std::move(blackboard);
+          s = slot{
+            .alive = true,
+            .generation = s.generation,
+            .group = group,
+            .clear_epoch = m_groups[group].clear_epoch
+          };
+          return id_at(machine);
+        }
+
+        m_blackboards.push_back(std::move(blackboard));
+        m_slots.push_back(slot{
+          .alive = true,
+          .group = group,
+          .clear_epoch = m_groups[group].clear_epoch
+        });
+        m_history.resize(m_slots.size() * m_history_capacity);
+        return id_at(m_slots.size() - 1);
+      }
+
+      /**
+       * @brief Pause every machine of a group, in O(1).
+       *
+       * The machines of a paused group are neither updated nor receive
+       * events. The `pause` method of their state is called by the next
+       * update, or when they receive an event or are transitioned, unless
+       * the group is resumed before. When called during an update, the
+       * group is paused once the update completes.
+       */
+      void pause_group(group_id group) {
+        if (group >= m_groups.size()) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::pause_group,
+            .request = {.id = no_machine, .target = std::monostate{}},
+            .group = group
+          });
+          return;
+        }
+
+        m_groups[group].paused = true;
+      }
+
+      /**
+       * @brief Resume every machine of a group, in O(1).
+       *
+       * The `resume` method of a state which was paused is called before its
+       * next update or event. When called during an update, the group is
+       * resumed once the update completes.
+       */
+      void resume_group(group_id group) {
+        if (group >= m_groups.size()) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::resume_group,
+            .request = {.id = no_machine, .target = std::monostate{}},
+            .group = group
+          });
+          return;
+        }
+
+        m_groups[group].paused = false;
+        m_groups[group].paused_all = false;
+      }
+
+      /**
+       * @brief Check if a group is paused.
+       */
+      bool is_group_paused(group_id group) const {
+        return group < m_groups.size() && m_groups[group].paused;
+      }
+
+      /**
+       * @brief Clear the state of every machine of a group, in O(1).
+       *
+       * The `exit` method of their state is called by the next update
+       * (unless the group is paused), or when they receive an event or are
+       * transitioned. When called during an update, the group is cleared
+       * once the update completes.
+       */
+      void clear_group(group_id group) {
+        if (group >= m_groups.size()) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::clear_group,
+            .request = {.id = no_machine, .target = std::monostate{}},
+            .group = group
+          });
+          return;
+        }
+
+        m_groups[group].clear_epoch++;
+        m_groups[group].clear_pending = true;
+      }
+
+      /**
+       * @brief Get the group of a machine.
+       */
+      group_id group_of(machine_id id) const {
+        return m_slots[slot_of(id)].group;
+      }
+
+      /**
+       * @brief Record the last `capacity` transitions of every machine.
+       *
+       * The histories of all the machines share one buffer, which only grows
+       * when machines are added. A capacity of 0 disables the history.
+       */
+      void enable_history(std::size_t capacity) {
+        m_history_capacity = capacity;
+        m_history.assign(m_slots.size() * capacity, history_entry{});
+
+        for (auto& s : m_slots) {
+          s.history_total = 0;
+        }
+      }
+
+      /**
+       * @brief Number of updates of the pool, used as the tick of the
+       * recorded transitions.
+       */
+      tick_type tick() const {
+        return m_tick;
+      }
+
+      /**
+       * @brief Call `fn(entry)` on the recorded transitions of a machine,
+       * from the oldest to the most recent.
+       */
+      template <typename F>
+      void history(machine_id id, F&& fn) const {
+        if (!contains(id) || m_history_capacity == 0) {
+          return;
+        }
+
+        auto total = m_slots[slot_of(id)].history_total;
+        auto count = std::min<std::uint64_t>(total, m_history_capacity);
+        auto base = slot_of(id) * m_history_capacity;
+
+        for (auto idx = total - count; idx < total; idx++) {
+          fn(m_history[base + idx % m_history_capacity]);
+        }
+      }
+
+      /**
+       * @brief Call `fn(id, entry)` on the recorded transitions of every
+       * machine.
+       */
+      template <typename F>
+      void dump_history(F&& fn) const {
+        for (std::size_t machine = 0; machine < m_slots.size(); machine++) {
+          auto id = id_at(machine);
+
+          history(id, [&](const history_entry& entry) {
+            fn(id, entry);
+          });
+        }
+      }
+
+      /**
+       * @brief Exit the current state of a machine (if any) and remove it.
+       *
+       * When called during an update or while delivering an event, the
+       * removal is deferred like any transition: the machine stays in the
+       * pool until the update completes. Its identifier becomes stale, the
+       * requests still targeting it are ignored.
+       */
+      void remove_machine(machine_id id) {
+        if (!contains(id)) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::remove,
+            .request = {.id = id, .target = std::monostate{}},
+            .group = 0
+          });
+          return;
+        }
+
+        clear_state(id);
+
+        auto machine = slot_of(id);
+        m_slots[machine].alive = false;
+        m_slots[machine].generation++;
+        m_free_slots.push_back(machine);
+      }
+
+      /**
+       * @brief Check if a machine is in the pool.
+       */
+      bool contains(machine_id id) const {
+        auto machine = slot_of(id);
+
+        return machine < m_slots.size()
+          && m_slots[machine].alive
+          && m_slots[machine].generation == id >> slot_bits;
+      }
+
+      /**
+       * @brief Number of machines in the pool.
+       */
+      std::size_t size() const {
+        return m_slots.size() - m_free_slots.size();
+      }
+
+      /**
+       * @brief Get the blackboard of a machine.
+       */
+      T& blackboard(machine_id id) {
+        return m_blackboards[slot_of(id)];
+      }
+
+      /**
+       * @brief Get the current state of a machine, or `no_state`.
+       */
+      state_id current_state(machine_id id) const {
+        auto& s = m_slots[slot_of(id)];
+        return s.clear_epoch == m_groups[s.group].clear_epoch ? s.state : no_state;
+      }
+
+      /**
+       * @brief Number of machines in a state.
+       */
+      template <state_trait<T> S>
+      requires (std::same_as<S, States> || ...)
+      std::size_t count() const {
+        return std::get<id_of<S>()>(m_buckets).states.size();
+      }
+
+      /**
+       * @brief Enters a machine in a new state, exiting the previous one
+       * (if any).
+       */
+      template <state_trait<T> S>
+      requires (std::same_as<S, States> || ...)
+      void set_state(machine_id id, S state) {
+        emplace_state<S>(id, std::move(state));
+      }
+
+      /**
+       * @brief Enters a machine in a new state constructed in place from
+       * `args`, exiting the previous one (if any).
+       *
+       * The states of the other machines of the same state type may move,
+       * this is O(number of groups).
+       */
+      template <state_trait<T> S, typename... Args>
+      requires (std::same_as<S, States> || ...) && std::constructible_from<S, Args...>
+      void emplace_state(machine_id id, Args&&... args) {
+        if (!contains(id)) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::transition,
+            .request = {
+              .id = id,
+              .target = pending_state(std::in_place_type<S>, std::forward<Args>(args)...)
+            },
+            .group = 0
+          });
+          return;
+        }
+
+        auto machine = slot_of(id);
+        apply_group_clear(machine);
+        apply_group_pause(machine);
+        record_history(machine, id_of<S>());
+        exit_state(machine);
+
+        constexpr auto I = id_of<S>();
+        auto index = insert_state<I>(machine, std::forward<Args>(args)...);
+        std::get<I>(m_buckets).states[index].S::enter(m_blackboards[machine]);
+
+        apply_group_pause(machine);
+      }
+
+      /**
+       * @brief Clear the current state of a machine.
+       */
+      void clear_state(machine_id id) {
+        if (!contains(id)) {
+          return;
+        }
+
+        if (m_updating) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::transition,
+            .request = {.id = id, .target = std::monostate{}},
+            .group = 0
+          });
+          return;
+        }
+
+        auto machine = slot_of(id);
+        apply_group_clear(machine);
+        apply_group_pause(machine);
+
+        if (m_slots[machine].state != no_state) {
+          record_history(machine, no_state);
+        }
+
+        exit_state(machine);
+      }
+
+      /**
+       * @brief Update all the machines, grouped by state.
+       */
+      void update() {
+        m_updating = true;
+
+        for_each_state([&]<std::size_t I>() {
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+
+          visit_bucket<I>([&](bucket_type<S>& bucket, std::size_t idx) {
+            bucket.states[idx].S::update(m_blackboards[bucket.owners[idx]]);
+          });
+        });
+
+        // Every machine of every group was visited, the lazy callbacks have
+        // been delivered.
+        for (auto& g : m_groups) {
+          if (g.paused) {
+            g.paused_all = true;
+          }
+          else {
+            g.has_paused = false;
+            g.clear_pending = false;
+          }
+        }
+
+        m_updating = false;
+        apply_pending();
+        m_tick++;
+      }
+
+      /**
+       * @brief Number of machines whose current state handles events of type
+       * `E`, including the paused ones.
+       */
+      template <typename E>
+      std::size_t subscriber_count() const {
+        auto count = std::size_t{0};
+
+        for_each_state([&]<std::size_t I>() {
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+
+          if constexpr (event_handler<S, T, E>) {
+            count += std::get<I>(m_buckets).states.size();
+          }
+        });
+
+        return count;
+      }
+
+      /**
+       * @brief Send an event to every machine whose current state handles it.
+       *
+       * Only the states handling `E` are visited, the others are skipped at
+       * compile time. Returns the number of machines which received the
+       * event.
+       */
+      template <typename E>
+      std::size_t broadcast(const E& event) {
+        auto received = std::size_t{0};
+        auto nested = std::exchange(m_updating, true);
+
+        for_each_state([&]<std::size_t I>() {
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+
+          if constexpr (event_handler<S, T, E>) {
+            visit_bucket<I>([&](bucket_type<S>& bucket, std::size_t idx) {
+              bucket.states[idx].on_event(event, m_blackboards[bucket.owners[idx]]);
+              received++;
+            });
+          }
+        });
+
+        m_updating = nested;
+        if (!nested) {
+          apply_pending();
+        }
+
+        return received;
+      }
+
+      /**
+       * @brief Send an event to one machine, returns `true` if its current
+       * state handles it.
+       */
+      template <typename E>
+      bool send(machine_id id, const E& event) {
+        if (!contains(id)) {
+          return false;
+        }
+
+        auto machine = slot_of(id);
+        auto current = m_slots[machine].state;
+        auto received = false;
+        auto nested = std::exchange(m_updating, true);
+
+        for_each_state([&]<std::size_t I>() {
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+
+          if constexpr (event_handler<S, T, E>) {
+            auto& bucket = std::get<I>(m_buckets);
+            auto idx = m_slots[machine].index;
+
+            if (I == current && prepare(bucket, idx)) {
+              bucket.states[idx].on_event(event, m_blackboards[machine]);
+              received = true;
+            }
+          }
+        });
+
+        m_updating = nested;
+        if (!nested) {
+          apply_pending();
+        }
+
+        return received;
+      }
+
+      /**
+       * @brief Apply the transitions posted to a queue, then update all the
+       * machines.
+       */
+      void update(event_queue<transition_request>& requests) {
+        requests.drain([&](transition_request request) {
+          apply(std::move(request));
+        });
+
+        update();
+      }
+
+    private:
+      // The states of a bucket are partitioned by group, the states of group
+      // `g` are in `[group_ends[g - 1], group_ends[g])`.
+      template <typename S>
+      struct bucket_type {
+        std::vector<S> states;
+        std::vector<std::size_t> owners;
+        std::vector<std::size_t> group_ends = std::vector<std::size_t>(1);
+      };
+
+      struct slot {
+        state_id state{no_state};
+        std::size_t index{0};
+        bool alive{false};
+        std::uint32_t generation{0};
+        std::uint64_t history_total{0};
+
+        group_id group{0};
+        std::uint64_t clear_epoch{0};
+        bool paused{false};
+      };
+
+      // The low bits of an identifier are the slot of the machine, the high
+      // bits the generation of the slot, incremented when a machine is
+      // removed.
+      static constexpr std::size_t slot_bits = sizeof(machine_id) * 4;
+
+      static std::size_t slot_of(machine_id id) {
+        return id & ((machine_id{1} << slot_bits) - 1);
+      }
+
+      machine_id id_at(std::size_t machine) const {
+        return machine_id{m_slots[machine].generation} << slot_bits | machine;
+      }
+
+      struct group_type {
+        bool paused{false};
+        bool paused_all{false};
+        bool has_paused{false};
+        bool clear_pending{false};
+        std::uint64_t clear_epoch{0};
+      };
+
+      // Call `fn(bucket, idx)` on the states of a bucket whose machines must
+      // run. The groups without pending lazy callbacks are visited without
+      // looking at their machines, the paused groups whose machines were all
+      // paused are skipped.
+      template <std::size_t I, typename F>
+      void visit_bucket(F&& fn) {
+        auto& bucket = std::get<I>(m_buckets);
+        auto first = std::size_t{0};
+
+        for (group_id group = 0; group < bucket.group_ends.size(); group++) {
+          auto last = bucket.group_ends[group];
+          auto& g = m_groups[group];
+
+          if (g.paused && g.paused_all) {
+            // Skipped as a whole.
+          }
+          else if (g.paused || g.has_paused || g.clear_pending) {
+            for (auto idx = first; idx < last; idx++) {
+              if (prepare(bucket, idx)) {
+                fn(bucket, idx);
+              }
+            }
+          }
+          else {
+            for (auto idx = first; idx < last; idx++) {
+              fn(bucket, idx);
+            }
+          }
+
+          first = last;
+        }
+      }
+
+      // Deliver the lazy callbacks of the group operations before a machine
+      // runs, returns `false` if it must be skipped. Only called while
+      // updating, so that a lazy clear is deferred like any transition.
+      template <typename S>
+      bool prepare(bucket_type<S>& bucket, std::size_t idx) {
+        auto machine = bucket.owners[idx];
+        auto& s = m_slots[machine];
+        auto& g = m_groups[s.group];
+
+        if (g.paused) {
+          if (!s.paused && s.clear_epoch == g.clear_epoch) {
+            s.paused = true;
+            g.has_paused = true;
+            bucket.states[idx].S::pause(m_blackboards[machine]);
+          }
+
+          return false;
+        }
+
+        if (s.clear_epoch != g.clear_epoch) {
+          m_pending.push_back(pending_request{
+            .kind = pending_kind::transition,
+            .request = {.id = id_at(machine), .target = std::monostate{}},
+            .group = 0
+          });
+          return false;
+        }
+
+        if (s.paused) {
+          s.paused = false;
+          bucket.states[idx].S::resume(m_blackboards[machine]);
+        }
+
+        return true;
+      }
+
+      // Deliver the lazy callbacks of the group operations before a machine
+      // is transitioned, and pause the state entered in a paused group.
+      void apply_group_pause(std::size_t machine) {
+        auto& s = m_slots[machine];
+        auto& g = m_groups[s.group];
+
+        if (s.state == no_state || s.paused || !g.paused) {
+          return;
+        }
+
+        s.paused = true;
+        g.has_paused = true;
+
+        for_each_state([&]<std::size_t I>() {
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+
+          if (I == s.state) {
+            std::get<I>(m_buckets).states[s.index].S::pause(m_blackboards[machine]);
+          }
+        });
+      }
+
+      void apply_group_clear(std::size_t machine) {
+        auto& s = m_slots[machine];
+        auto epoch = m_groups[s.group].clear_epoch;
+
+        if (s.clear_epoch == epoch) {
+          return;
+        }
+
+        if (s.state != no_state) {
+          record_history(machine, no_state);
+        }
+
+        exit_state(machine);
+        m_slots[machine].clear_epoch = epoch;
+      }
+
+      void record_history(std::size_t machine, state_id to) {
+        if (m_history_capacity == 0) {
+          return;
+        }
+
+        auto& s = m_slots[machine];
+        auto idx = machine * m_history_capacity + s.history_total % m_history_capacity;
+        m_history[idx] = history_entry{m_tick, s.state, to};
+        s.history_total++;
+      }
+
+      using pending_state = std::variant<std::monostate, States...>;
+
+      enum class pending_kind {
+        transition,
+        remove,
+        pause_group,
+        resume_group,
+        clear_group
+      };
+
+      // A transition or a group operation deferred until the end of an
+      // update, or the removal of a machine.
+      struct pending_request {
+        pending_kind kind{pending_kind::transition};
+        transition_request request;
+        group_id group{0};
+      };
+
+      template <typename F>
+      static void for_each_state(F&& fn) {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+          (fn.template operator()<I>(), ...);
+        }(std::index_sequence_for<States...>{});
+      }
+
+      template <typename S>
+      void move_state(bucket_type<S>& bucket, std::size_t from, std::size_t to) {
+        std::destroy_at(&bucket.states[to]);
+        std::construct_at(&bucket.states[to], std::move(bucket.states[from]));
+        bucket.owners[to] = bucket.owners[from];
+        m_slots[bucket.owners[to]].index = to;
+      }
+
+      // Construct a state at the end of the range of the machine's group,
+      // the first state of every following group moves to the end of its
+      // own range to make room. Returns the index of the new state.
+      template <std::size_t I, typename... Args>
+      std::size_t insert_state(std::size_t machine, Args&&... args) {
+        auto& bucket = std::get<I>(m_buckets);
+        auto& ends = bucket.group_ends;
+        auto group = m_slots[machine].group;
+        auto hole = bucket.states.size();
+
+        for (auto g = ends.size() - 1; g > group; g--) {
+          auto first = ends[g - 1];
+
+          if (first != hole) {
+            if (hole == bucket.states.size()) {
+              auto moved = std::move(bucket.states[first]);
+              auto owner = bucket.owners[first];
+
+              bucket.states.push_back(std::move(moved));
+              bucket.owners.push_back(owner);
+              m_slots[owner].index = hole;
+            }
+            else {
+              move_state(bucket, first, hole);
+            }
+          }
+
+          ends[g]++;
+          hole = first;
+        }
+
+        if (hole == bucket.states.size()) {
+          bucket.states.emplace_back(std::forward<Args>(args)...);
+          bucket.owners.push_back(machine);
+        }
+        else {
+          std::destroy_at(&bucket.states[hole]);
+          std::construct_at(&bucket.states[hole], std::forward<Args>(args)...);
+          bucket.owners[hole] = machine;
+        }
+
+        ends[group]++;
+
+        auto& s = m_slots[machine];
+        s.state = I;
+        s.index = hole;
+        s.paused = false;
+        return hole;
+      }
+
+      void exit_state(std::size_t machine) {
+        auto current = m_slots[machine].state;
+        if (current == no_state) {
+          return;
+        }
+
+        for_each_state([&]<std::size_t I>() {
+          if (I != current) {
+            return;
+          }
+
+          using S = std::tuple_element_t<I, std::tuple<States...>>;
+          auto& bucket = std::get<I>(m_buckets);
+          auto& ends = bucket.group_ends;
+
+          bucket.states[m_slots[machine].index].S::exit(m_blackboards[machine]);
+
+          // Fill the hole with the last state of the group, then move the
+          // hole to the end of the array, one group at a time.
+          auto hole = m_slots[machine].index;
+          for (auto g = m_slots[machine].group; g < ends.size(); g++) {
+            auto last = ends[g] - 1;
+
+            if (last != hole) {
+              move_state(bucket, last, hole);
+            }
+
+            ends[g]--;
+            hole = last;
+          }
+
+          bucket.states.pop_back();
+          bucket.owners.pop_back();
+        });
+
+        m_slots[machine].state = no_state;
+        m_slots[machine].paused = false;
+      }
+
+      void apply(transition_request request) {
+        std::visit(
+          [&]<typename S>(S& target) {
+            if constexpr (std::same_as<S, std::monostate>) {
+              clear_state(request.id);
+            }
+            else {
+              emplace_state<S>(request.id, std::move(target));
+            }
+          },
+          request.target
+        );
+      }
+
+      void apply_pending() {
+        for (std::size_t idx = 0; idx < m_pending.size(); idx++) {
+          auto& pending = m_pending[idx];
+
+          switch (pending.kind) {
+            case pending_kind::transition:
+              apply(std::move(pending.request));
+              break;
+
+            case pending_kind::remove:
+              remove_machine(pending.request.id);
+              break;
+
+            case pending_kind::pause_group:
+              pause_group(pending.group);
+              break;
+
+            case pending_kind::resume_group:
+              resume_group(pending.group);
+              break;
+
+            case pending_kind::clear_group:
+              clear_group(pending.group);
+              break;
+          }
+        }
+
+        m_pending.clear();
+      }
+
+    private:
+      std::vector<T> m_blackboards;
+      std::vector<slot> m_slots;
+      std::vector<std::size_t> m_free_slots;
+      std::tuple<bucket_type<States>...> m_buckets;
+
+      std::vector<pending_request> m_pending;
+      bool m_updating{false};
+
+      std::vector<history_entry> m_history;
+      std::size_t m_history_capacity{0};
+      tick_type m_tick{0};
+
+      std::vector<group_type> m_groups = std::vector<group_type>(1);
+  };
+
+  template <typename T>
+  class coroutine_state;
+
+  /**
+   * @ingroup fsm
+   * @brief A state telling a `machine_scheduler` the tick of its next update.
+   *
+   * `next_update` is called after `enter` and after every `update`, the
+   * states without it are updated at every tick.
+   */
+  template <typename S, typename T>
+  concept scheduled_state = state_trait<S, T> && requires(S& state, T& blackboard, tick_type now) {
+    { state.next_update(blackboard, now) } -> std::convertible_to<tick_type>;
+  };
+
+  /**
+   * @ingroup fsm
+   * @class machine_scheduler
+   * @brief Many simple FSMs, only updated when their current state asks for
+   * it.
+   *
+   * Wake times are stored in a hierarchical timer wheel: every level has 256
+   * slots, and each level is 256 times coarser than the previous one. A slot
+   * of an upper level is moved down when the current tick reaches it, so that
+   * scheduling and updating a machine are O(1).
+   */
+  template <typename T>
+  class machine_scheduler {
+    public:
+      /**
+       * @brief Add a machine without any state, returns its identifier.
+       *
+       * Identifiers of removed machines are reused.
+       */
+      machine_id add_machine(T blackboard) {
+        auto id = machine_id{0};
+
+        if (!m_free_ids.empty()) {
+          id = m_free_ids.back();
+          m_free_ids.pop_back();
+
+          m_records[id].blackboard = std::move(blackboard);
+          m_records[id].alive = true;
+        }
+        else {
+          id = m_records.size();
+          m_records.push_back(record{
+            .machine = simple_machine<T>{},
+            .blackboard = std::move(blackboard),
+            .wake_tick = wake_on_event,
+            .scheduled_type = nullptr,
+            .next_update = nullptr,
+            .generation = 0,
+            .alive = true
+          });
+        }
+
+        return id;
+      }
+
+      /**
+       * @brief Exit the current state of a machine (if any) and remove it.
+       */
+      void remove_machine(machine_id id) {
+        if (!contains(id)) {
+          return;
+        }
+
+        auto& rec = m_records[id];
+        rec.machine.clear_state(rec.blackboard);
+        rec.machine = simple_machine<T>{};
+        rec.wake_tick = wake_on_event;
+        rec.scheduled_type = nullptr;
+        rec.next_update = nullptr;
+        rec.generation++;
+        rec.alive = false;
+        m_free_ids.push_back(id);
+      }
+
+      /**
+       * @brief Check if a machine is in the scheduler.
+       */
+      bool contains(machine_id id) const {
+        return id < m_records.size() && m_records[id].alive;
+      }
+
+      /**
+       * @brief Number of machines in the scheduler.
+       */
+      std::size_t size() const {
+        return m_records.size() - m_free_ids.size();
+      }
+
+      /**
+       * @brief Get the machine, call `wake()` after changing it outside of an
+       * update.
+       */
+      simple_machine<T>& machine(machine_id id) {
+        return m_records[id].machine;
+      }
+
+      /**
+       * @brief Get the blackboard of a machine.
+       */
+      T& blackboard(machine_id id) {
+        return m_records[id].blackboard;
+      }
+
+      /**
+       * @brief Enter a machine in a new state, and schedule it as requested
+       * by the new state.
+       */
+      template <state_trait<T> S>
+      void set_state(machine_id id, S state) {
+        emplace_state<S>(id, std::move(state));
+      }
+
+      /**
+       * @brief Enter a machine in a new state constructed in place from
+       * `args`, and schedule it as requested by the new state.
+       */
+      template <state_trait<T> S, typename... Args>
+      requires std::constructible_from<S, Args...>
+      void emplace_state(machine_id id, Args&&... args) {
+        static_assert(
+          !std::derived_from<S, coroutine_state<T>>,
+          "the blackboards of a machine_scheduler are moved, a coroutine state would keep a dangling reference"
+        );
+
+        auto& rec = m_records[id];
+        rec.machine.template emplace_state<S>(rec.blackboard, std::forward<Args>(args)...);
+
+        if constexpr (scheduled_state<S, T>) {
+          rec.scheduled_type = &typeid(S);
+          rec.next_update = &call_next_update<S>;
+        }
+        else {
+          rec.scheduled_type = nullptr;
+          rec.next_update = nullptr;
+        }
+
+        schedule(id, next_update(rec));
+      }
+
+      /**
+       * @brief Update a machine at the next call to `update()`, whatever its
+       * wake time.
+       */
+      void wake(machine_id id) {
+        if (!contains(id)) {
+          return;
+        }
+
+        schedule(id, next_tick());
+      }
+
+      /**
+       * @brief Tick of the next call to `update()`.
+       */
+      tick_type now() const {
+        return m_now;
+      }
+
+      /**
+       * @brief Tick of the next update of a machine, `wake_on_event` if it is
+       * not scheduled.
+       */
+      tick_type wake_tick(machine_id id) const {
+        return m_records[id].wake_tick;
+      }
+
+      /**
+       * @brief Update the machines whose wake time has arrived, then advance
+       * to the next tick.
+       *
+       * Returns the number of updated machines.
+       */
+      std::size_t update() {
+        cascade();
+
+        auto updated = std::size_t{0};
+        auto& due = m_wheel[0][m_now & slot_mask];
+
+        m_updating = true;
+        m_due.swap(due);
+
+        for (auto& e : m_due) {
+          auto& rec = m_records[e.id];
+
+          if (!rec.alive || rec.generation != e.generation) {
+            continue;
+          }
+
+          if (rec.wake_tick != m_now) {
+            insert(e.id);
+            continue;
+          }
+
+          rec.machine.update(rec.blackboard);
+          updated++;
+
+          // The state may have been changed or woken up during the update.
+          if (rec.generation == e.generation) {
+            schedule(e.id, next_update(rec));
+          }
+        }
+
+        m_due.clear();
+        m_updating = false;
+        m_now++;
+
+        return updated;
+      }
+
+    private:
+      static constexpr std::size_t level_count = 4;
+      static constexpr std::size_t slot_bits = 8;
+      static constexpr tick_type slot_mask = (tick_type{1} << slot_bits) - 1;
+
+      using next_update_fn = tick_type (*)(state<T>&, T&, tick_type);
+
+      // The next_update hook of the state entered by emplace_state, only
+      // used while the current state is still of that type.
+      struct record {
+        simple_machine<T> machine;
+        T blackboard;
+        tick_type wake_tick{wake_on_event};
+        const std::type_info* scheduled_type{nullptr};
+        next_update_fn next_update{nullptr};
+        std::uint32_t generation{0};
+        bool alive{false};
+      };
+
+      struct entry {
+        machine_id id;
+        std::uint32_t generation;
+      };
+
+      tick_type next_tick() const {
+        return m_updating ? m_now + 1 : m_now;
+      }
+
+      template <typename S>
+      static tick_type call_next_update(state<T>& state, T& blackboard, tick_type now) {
+        return static_cast<S&>(state).next_update(blackboard, now);
+      }
+
+      tick_type next_update(record& rec) const {
+        auto current = rec.machine.current_state();
+        if (current == nullptr || rec.machine.is_paused()) {
+          return wake_on_event;
+        }
+
+        if (rec.next_update != nullptr && typeid(*current) == *rec.scheduled_type) {
+          return rec.next_update(*current, rec.blackboard, m_now);
+        }
+
+        return m_now + 1;
+      }
+
+      void schedule(machine_id id, tick_type tick) {
+        auto& rec = m_records[id];
+
+        rec.generation++;
+        rec.wake_tick = tick == wake_on_event ? tick : std::max(tick, next_tick());
+
+        if (rec.wake_tick != wake_on_event) {
+          insert(id);
+        }
+      }
+
+      // Entries further than the wheel can hold are stored in the last slot
+      // of the top level, and inserted again when it is reached.
+      void insert(machine_id id) {
+        auto& rec = m_records[id];
+        auto delta = rec.wake_tick - m_now;
+        auto tick = rec.wake_tick;
+        auto level = std::size_t{0};
+
+        while (level + 1 < level_count && delta >> (slot_bits * (level + 1)) != 0) {
+          level++;
+        }
+
+        if (delta >> (slot_bits * level_count) != 0) {
+          tick = m_now + (tick_type{1} << (slot_bits * level_count)) - 1;
+        }
+
+        auto slot = (tick >> (slot_bits * level)) & slot_mask;
+        m_wheel[level][slot].push_back(entry{id, rec.generation});
+      }
+
+      // Move the entries of the upper levels that are due in the next 256
+      // ticks to the lower levels, starting from the top.
+      void cascade() {
+        for (std::size_t level = level_count - 1; level > 0; level--) {
+          if ((m_now & ((tick_type{1} << (slot_bits * level)) - 1)) != 0) {
+            continue;
+          }
+
+          auto slot = (m_now >> (slot_bits * level)) & slot_mask;
+          auto entries = std::move(m_wheel[level][slot]);
+          m_wheel[level][slot].clear();
+
+          for (auto& e : entries) {
+            auto& rec = m_records[e.id];
+
+            if (rec.alive && rec.generation == e.generation) {
+              insert(e.id);
+            }
+          }
+        }
+      }
+
+    private:
+      std::vector<record> m_records;
+      std::vector<machine_id> m_free_ids;
+
+      std::array<std::array<std::vector<entry>, slot_mask + 1>, level_count> m_wheel;
+      std::vector<entry> m_due;
+
+      tick_type m_now{0};
+      bool m_updating{false};
+  };
+
+  namespace detail {
+    /**
+     * Thread-local free lists of coroutine frames, by size class. Frames
+     * larger than the biggest class are allocated on the heap.
+     */
+    class frame_pool {
+      public:
+        static constexpr std::size_t granularity = 64;
+        static constexpr std::size_t class_count = 16;
+
+        frame_pool() = default;
+        frame_pool(const frame_pool&) = delete;
+        frame_pool& operator=(const frame_pool&) = delete;
+
+        ~frame_pool() {
+          for (auto head : m_free) {
+            while (head != nullptr) {
+              auto next = head->next;
+              ::operator delete(head);
+              head = next;
+            }
+          }
+        }
+
+        static void* allocate(std::size_t size) {
+          auto size_class = (size + granularity - 1) / granularity;
+          if (size_class > class_count) {
+            return ::operator new(size);
+          }
+
+          auto& head = local().m_free[size_class - 1];
+          if (head != nullptr) {
+            auto block = head;
+            head = head->next;
+            return block;
+          }
+
+          return ::operator new(size_class * granularity);
+        }
+
+        static void deallocate(void* ptr, std::size_t size) {
+          auto size_class = (size + granularity - 1) / granularity;
+          if (size_class > class_count) {
+            ::operator delete(ptr);
+            return;
+          }
+
+          auto& head = local().m_free[size_class - 1];
+          head = ::new (ptr) free_block{head};
+        }
+
+      private:
+        struct free_block {
+          free_block* next;
+        };
+
+        static frame_pool& local() {
+          thread_local frame_pool pool;
+          return pool;
+        }
+
+      private:
+        std::array<free_block*, class_count> m_free{};
+    };
+  }
+
+  /**
+   * @ingroup fsm
+   * @class state_task
+   * @brief Coroutine returned by `coroutine_state::run()`.
+   *
+   * The frame of the coroutine comes from a thread-local pool.
+   */
+  class state_task {
+    public:
+      struct promise_type {
+        state_task get_return_object() {
+          return state_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(std::size_t size) {
+          return detail::frame_pool::allocate(size);
+        }
+
+        static void operator delete(void* ptr, std::size_t size) {
+          detail::frame_pool::deallocate(ptr, size);
+        }
+
+        std::size_t wait_ticks{0};
+        std::optional<event_id> wait_event;
+        bool (*wait_predicate)(void*){nullptr};
+        void* wait_context{nullptr};
+      };
+
+      using handle_type = std::coroutine_handle<promise_type>;
+
+      state_task() = default;
+
+      state_task(state_task&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+      state_task& operator=(state_task&& other) noexcept {
+        if (this != &other) {
+          reset();
+          m_handle = std::exchange(other.m_handle, nullptr);
+        }
+
+        return *this;
+      }
+
+      ~state_task() {
+        reset();
+      }
+
+      /**
+       * @brief Check if the coroutine returned (or was never started).
+       */
+      bool done() const {
+        return !m_handle || m_handle.done();
+      }
+
+      /**
+       * @brief Resume the coroutine if what it awaits is ready.
+       */
+      void tick() {
+        if (done()) {
+          return;
+        }
+
+        auto& promise = m_handle.promise();
+
+        if (promise.wait_event) {
+          return;
+        }
+
+        if (promise.wait_ticks > 0 && --promise.wait_ticks > 0) {
+          return;
+        }
+
+        if (promise.wait_predicate != nullptr && !promise.wait_predicate(promise.wait_context)) {
+          return;
+        }
+
+        promise.wait_predicate = nullptr;
+        promise.wait_context = nullptr;
+        m_handle.resume();
+      }
+
+      /**
+       * @brief Resume the coroutine if it awaits `event`.
+       */
+      void notify(event_id event) {
+        if (done()) {
+          return;
+        }
+
+        auto& promise = m_handle.promise();
+
+        if (promise.wait_event == event) {
+          promise.wait_event.reset();
+          m_handle.resume();
+        }
+      }
+
+    private:
+      explicit state_task(handle_type handle) : m_handle(handle) {}
+
+      void reset() {
+        if (m_handle) {
+          m_handle.destroy();
+          m_handle = nullptr;
+        }
+      }
+
+    private:
+      handle_type m_handle{nullptr};
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Awaitable suspending a `state_task` until the next update.
+   */
+  struct next_tick {
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(state_task::handle_type handle) const noexcept {
+      handle.promise().wait_ticks = 1;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Awaitable suspending a `state_task` for `count` updates.
+   */
+  struct wait_ticks {
+    std::size_t count;
+
+    bool await_ready() const noexcept { return count == 0; }
+
+    void await_suspend(state_task::handle_type handle) const noexcept {
+      handle.promise().wait_ticks = count;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   * @ingroup fsm
+   * @brief Awaitable suspending a `state_task` until `predicate()` is true,
+   * checked at every update.
+   */
+  template <std::predicate F>
+  struct wait_until {
+    F predicate;
+
+    bool await_ready() { return predicate(); }
+
+    void await_suspend(state_task::handle_type handle) noexcept {
+      auto& promise = handle.promise();
+      promise.wait_context = &predicate;
+      promise.wait_predicate = [](void* context) -> bool {
+        return (*static_cast<F*>(context))();
+      };
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  template <typename F>
+  wait_until(F) -> wait_until<F>;
+
+  /**
+   * @ingroup fsm
+   * @brief Awaitable suspending a `state_task` until the event is notified.
+   */
+  struct wait_event {
+    event_id event;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(state_task::handle_type handle) const noexcept {
+      handle.promise().wait_event = event;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   * @ingroup fsm
+   * @class coroutine_state
+   * @brief A state whose behavior is a coroutine, started when entering the
+   * state and resumed by its updates.
+   */
+  template <typename T>
+  class coroutine_state : public state<T> {
+    public:
+      coroutine_state() = default;
+
+      // The coroutine frame points to the state.
+      coroutine_state(const coroutine_state&) = delete;
+      coroutine_state& operator=(const coroutine_state&) = delete;
+
+      /**
+       * @brief Body of the state, the blackboard is the one given to `enter`.
+       *
+       * The blackboard must not move until the state is exited.
+       */
+      virtual state_task run(T& blackboard) = 0;
+
+      virtual void enter(T& blackboard) override {
+        m_task = run(blackboard);
+      }
+
+      virtual void exit(T& blackboard) override {
+        m_task = state_task{};
+      }
+
+      virtual void update(T& blackboard) override {
+        m_task.tick();
+      }
+
+      /**
+       * @brief Resume the coroutine if it awaits `event`.
+       */
+      void notify(event_id event) {
+        m_task.notify(event);
+      }
+
+      /**
+       * @brief Check if the coroutine returned.
+       */
+      bool done() const {
+        return m_task.done();
+      }
+
+    private:
+      state_task m_task;
   };
 }
@@ -338,3 +338,423 @@ TEST_CASE("behtree sel node evaluation") {
     CHECK(blackboard.node_count == 1);
   }
 }
+
+TEST_CASE("behtree utility_sel node evaluation") {
+  SUBCASE("utility_sel node executes the best scored child first") {
+    blackboard_type blackboard;
+
+    auto sel_node = utility_sel<blackboard_type>(
+      node_list<blackboard_type>(
+        task<blackboard_type>([](auto& blackboard) {
+          blackboard.node_count += 1;
+          return execution_state::success;
+        }),
+        task<blackboard_type>([](auto& blackboard) {
+          blackboard.node_count += 10;
+          return execution_state::success;
+        })
+      ),
+      {
+        [](auto& blackboard) { return 1.0f; },
+        [](auto& blackboard) { return 2.0f; }
+      }
+    );
+
+    auto state = sel_node.evaluate(blackboard);
+
+    CHECK(state == execution_state::success);
+    CHECK(blackboard.node_count == 10);
+  }
+
+  SUBCASE("utility_sel node falls back to the next best child on failure") {
+    blackboard_type blackboard;
+
+    auto sel_node = utility_sel<blackboard_type>(
+      node_list<blackboard_type>(
+        task<blackboard_type>([](auto& blackboard) {
+          blackboard.node_count += 1;
+          return execution_state::success;
+        }),
+        task<blackboard_type>([](auto& blackboard) {
+          blackboard.node_count += 10;
+          return execution_state::failure;
+        })
+      ),
+      {
+        [](auto& blackboard) { return 1.0f; },
+        [](auto& blackboard) { return 2.0f; }
+      }
+    );
+
+    auto state = sel_node.evaluate(blackboard);
+
+    CHECK(state == execution_state::success);
+    CHECK(blackboard.node_count == 11);
+  }
+
+  SUBCASE("utility_sel node caches the scores") {
+    blackboard_type blackboard;
+    int score_calls = 0;
+    std::uint64_t version = 0;
+
+    auto sel_node = utility_sel<blackboard_type>(
+      node_list<blackboard_type>(
+        task<blackboard_type>([](auto& blackboard) {
+          return execution_state::success;
+        })
+      ),
+      {
+        [&](auto& blackboard) {
+          score_calls++;
+          return 1.0f;
+        }
+      },
+      3,
+      [&](auto& blackboard) { return version; }
+    );
+
+    for (int i = 0; i < 3; i++) {
+      sel_node.evaluate(blackboard);
+    }
+    CHECK(score_calls == 1);
+
+    sel_node.evaluate(blackboard);
+    CHECK(score_calls == 2);
+
+    version++;
+    sel_node.evaluate(blackboard);
+    CHECK(score_calls == 3);
+
+    sel_node.mark_dirty();
+    sel_node.evaluate(blackboard);
+    CHECK(score_calls == 4);
+  }
+}
+
+TEST_CASE("behtree reactive_sel node evaluation") {
+  struct reactive_blackboard {
+    bool enemy_in_range{false};
+    bool in_cover{true};
+    int attack_count{0};
+    int patrol_count{0};
+    mutable int patrol_checks{0};
+  };
+
+  auto make_tree = []() {
+    return reactive_sel<reactive_blackboard>(
+      node_list<reactive_blackboard>(
+        guard<reactive_blackboard>(
+          check<reactive_blackboard>([](auto& blackboard) {
+            return blackboard.enemy_in_range;
+          }),
+          task<reactive_blackboard>([](auto& blackboard) {
+            blackboard.attack_count++;
+            return execution_state::running;
+          })
+        ),
+        guard<reactive_blackboard>(
+          check<reactive_blackboard>([](auto& blackboard) {
+            blackboard.patrol_checks++;
+            return blackboard.in_cover;
+          }),
+          task<reactive_blackboard>([](auto& blackboard) {
+            blackboard.patrol_count++;
+            return execution_state::running;
+          })
+        )
+      )
+    );
+  };
+
+  SUBCASE("reactive_sel node resumes the running child while guards hold") {
+    reactive_blackboard blackboard;
+    auto tree = make_tree();
+
+    for (int i = 0; i < 3; i++) {
+      CHECK(tree.evaluate(blackboard) == execution_state::running);
+    }
+
+    CHECK(blackboard.attack_count == 0);
+    CHECK(blackboard.patrol_count == 3);
+    CHECK(blackboard.patrol_checks == 3);
+  }
+
+  SUBCASE("reactive_sel node interrupts the running child when a higher guard flips") {
+    reactive_blackboard blackboard;
+    auto tree = make_tree();
+
+    tree.evaluate(blackboard);
+    blackboard.enemy_in_range = true;
+    tree.evaluate(blackboard);
+
+    CHECK(blackboard.attack_count == 1);
+    CHECK(blackboard.patrol_count == 1);
+
+    tree.evaluate(blackboard);
+
+    CHECK(blackboard.attack_count == 2);
+    CHECK(blackboard.patrol_checks == 1);
+  }
+
+  SUBCASE("reactive_sel node interrupts the running child when its guard flips") {
+    reactive_blackboard blackboard;
+    auto tree = make_tree();
+
+    tree.evaluate(blackboard);
+    blackboard.in_cover = false;
+
+    CHECK(tree.evaluate(blackboard) == execution_state::failure);
+    CHECK(blackboard.patrol_count == 1);
+  }
+
+  SUBCASE("guard node executes its child only if the condition holds") {
+    reactive_blackboard blackboard;
+
+    auto guard_node = guard<reactive_blackboard>(
+      check<reactive_blackboard>([](auto& blackboard) {
+        return blackboard.enemy_in_range;
+      }),
+      task<reactive_blackboard>([](auto& blackboard) {
+        blackboard.attack_count++;
+        return execution_state::success;
+      })
+    );
+
+    CHECK(guard_node.evaluate(blackboard) == execution_state::failure);
+    blackboard.enemy_in_range = true;
+    CHECK(guard_node.evaluate(blackboard) == execution_state::success);
+    CHECK(blackboard.attack_count == 1);
+  }
+}
+
+TEST_CASE("behtree halting skipped children") {
+  struct nested_blackboard {
+    bool alarm{false};
+    int alarm_count{0};
+    int search_count{0};
+    int patrol_count{0};
+  };
+
+  auto tree = sel<nested_blackboard>(
+    node_list<nested_blackboard>(
+      seq<nested_blackboard>(
+        node_list<nested_blackboard>(
+          check<nested_blackboard>([](auto& blackboard) {
+            return blackboard.alarm;
+          }),
+          task<nested_blackboard>([](auto& blackboard) {
+            blackboard.alarm_count++;
+            return execution_state::running;
+          })
+        )
+      ),
+      reactive_sel<nested_blackboard>(
+        node_list<nested_blackboard>(
+          task<nested_blackboard>([](auto& blackboard) {
+            blackboard.search_count++;
+            return execution_state::failure;
+          }),
+          task<nested_blackboard>([](auto& blackboard) {
+            blackboard.patrol_count++;
+            return execution_state::running;
+          })
+        )
+      )
+    )
+  );
+
+  nested_blackboard blackboard;
+
+  CHECK(tree.has_agent_state());
+
+  auto stateless = sel<nested_blackboard>(
+    node_list<nested_blackboard>(
+      task<nested_blackboard>([](auto&) { return execution_state::running; })
+    )
+  );
+  CHECK_FALSE(stateless.has_agent_state());
+
+  CHECK(tree.evaluate(blackboard) == execution_state::running);
+  CHECK(tree.evaluate(blackboard) == execution_state::running);
+  CHECK(blackboard.search_count == 1);
+  CHECK(blackboard.patrol_count == 2);
+
+  blackboard.alarm = true;
+  CHECK(tree.evaluate(blackboard) == execution_state::running);
+  CHECK(blackboard.alarm_count == 1);
+
+  // the reactive_sel node was halted, it starts again from its first child
+  blackboard.alarm = false;
+  CHECK(tree.evaluate(blackboard) == execution_state::running);
+  CHECK(blackboard.search_count == 2);
+  CHECK(blackboard.patrol_count == 3);
+}
+
+TEST_CASE("behtree clone") {
+  SUBCASE("cloned tree evaluates like the prototype") {
+    blackboard_type blackboard;
+
+    auto prototype = sel<blackboard_type>(
+      node_list<blackboard_type>(
+        neg<blackboard_type>(
+          check<blackboard_type>([](auto& blackboard) {
+            return true;
+          })
+        ),
+        seq<blackboard_type>(
+          node_list<blackboard_type>(
+            task<blackboard_type>([](auto& blackboard) {
+              blackboard.node_count++;
+              return execution_state::success;
+            }),
+            task<blackboard_type>([](auto& blackboard) {
+              blackboard.node_count++;
+              return execution_state::running;
+            })
+          )
+        )
+      )
+    );
+
+    auto tree = prototype.clone();
+    REQUIRE(tree != nullptr);
+
+    auto state = tree->evaluate(blackboard);
+
+    CHECK(state == execution_state::running);
+    CHECK(blackboard.node_count == 2);
+    CHECK(tree->footprint().total() == prototype.footprint().total());
+  }
+
+  SUBCASE("clone_n writes clones into preallocated slots") {
+    auto prototype = task<blackboard_type>([](auto& blackboard) {
+      return execution_state::success;
+    });
+
+    auto trees = std::vector<node_ptr<blackboard_type>>(3);
+    auto last = clone_n(prototype, trees.size(), trees.begin());
+
+    CHECK(last == trees.end());
+    for (auto& tree : trees) {
+      REQUIRE(tree != nullptr);
+      CHECK(tree.get() != &prototype);
+    }
+  }
+
+  SUBCASE("clones have their own per-agent state") {
+    struct watch_blackboard {
+      bool alarm{false};
+      int work{0};
+    };
+
+    auto prototype = reactive_sel<watch_blackboard>(
+      node_list<watch_blackboard>(
+        guard<watch_blackboard>(
+          check<watch_blackboard>([](auto& blackboard) {
+            return blackboard.alarm;
+          }),
+          task<watch_blackboard>([](auto& blackboard) {
+            return execution_state::success;
+          })
+        ),
+        task<watch_blackboard>([](auto& blackboard) {
+          blackboard.work++;
+          return execution_state::running;
+        })
+      )
+    );
+
+    auto a = prototype.clone();
+    auto b = prototype.clone();
+
+    auto bb_a = watch_blackboard{};
+    auto bb_b = watch_blackboard{.alarm = true};
+
+    CHECK(a->evaluate(bb_a) == execution_state::running);
+    CHECK(b->evaluate(bb_b) == execution_state::success);
+    CHECK(a->evaluate(bb_a) == execution_state::running);
+    CHECK(bb_a.work == 2);
+    CHECK(bb_b.work == 0);
+  }
+}
+
+TEST_CASE("behtree memory footprint") {
+  SUBCASE("footprint accounts for every node and child vector") {
+    auto tree = seq<blackboard_type>(
+      node_list<blackboard_type>(
+        check<blackboard_type>([](auto& blackboard) {
+          return true;
+        }),
+        neg<blackboard_type>(
+          task<blackboard_type>([](auto& blackboard) {
+            return execution_state::failure;
+          })
+        )
+      )
+    );
+
+    auto fp = tree.footprint();
+
+    CHECK(fp.node_count == 4);
+    CHECK(fp.nodes == (
+      sizeof(seq<blackboard_type>) +
+      sizeof(check<blackboard_type>) +
+      sizeof(neg<blackboard_type>) +
+      sizeof(task<blackboard_type>)
+    ));
+    CHECK(fp.children == 3 * sizeof(node_ptr<blackboard_type>));
+    CHECK(fp.unused_capacity == 0);
+    CHECK(fp.callbacks == 0);
+    CHECK(fp.total() == fp.nodes + fp.children);
+  }
+
+  SUBCASE("footprint detects callbacks stored on the heap") {
+    struct large_capture {
+      char data[256];
+    };
+
+    auto capture = large_capture{};
+    auto task_node = task<blackboard_type>([capture](auto& blackboard) {
+      return capture.data[0] == 0 ? execution_state::success : execution_state::failure;
+    });
+
+    CHECK(task_node.footprint().callbacks >= sizeof(large_capture));
+    CHECK(task_node.clone()->footprint().callbacks == task_node.footprint().callbacks);
+  }
+
+  SUBCASE("footprint reports the reserved capacity") {
+    auto children = std::vector<node_ptr<blackboard_type>>{};
+    children.reserve(8);
+    children.push_back(std::make_unique<check<blackboard_type>>([](auto& blackboard) {
+      return true;
+    }));
+    children.push_back(std::make_unique<check<blackboard_type>>([](auto& blackboard) {
+      return false;
+    }));
+
+    auto tree = sel<blackboard_type>(std::move(children));
+    auto fp = tree.footprint();
+
+    CHECK(fp.children == 2 * sizeof(node_ptr<blackboard_type>));
+    CHECK(fp.unused_capacity == 6 * sizeof(node_ptr<blackboard_type>));
+    CHECK(fp.total() == fp.nodes + fp.children + fp.unused_capacity);
+  }
+
+  SUBCASE("footprints of many trees can be aggregated") {
+    auto trees = std::vector<node_ptr<blackboard_type>>{};
+    for (int i = 0; i < 3; i++) {
+      trees.push_back(std::make_unique<sel<blackboard_type>>(
+        node_list<blackboard_type>(
+          check<blackboard_type>([](auto& blackboard) {
+            return false;
+          })
+        )
+      ));
+    }
+
+    auto fp = total_footprint<blackboard_type>(trees);
+
+    CHECK(fp.node_count == 6);
+    CHECK(fp.total() == 3 * trees.front()->footprint().total());
+  }
+}
@@ -1,3 +1,8 @@
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <vector>
+
 #include "doctest.h"
 
 #include "../include/aitoolkit/fsm.hpp"
@@ -90,3 +95,1419 @@ TEST_CASE("fsm stack machine") {
   fsm.pop_state(blackboard);
   CHECK(blackboard.exit == 1);
 }
+
+TEST_CASE("fsm fixed-capacity stack machine") {
+  auto blackboard = blackboard_type{};
+  auto fsm = stack_machine<blackboard_type, 2>{};
+
+  CHECK(fsm.capacity() == 2);
+
+  CHECK(fsm.push_state(state_dummy{1}, blackboard));
+  CHECK(blackboard.enter == 1);
+
+  CHECK(fsm.emplace_state<state_dummy>(blackboard, 2));
+  CHECK(blackboard.enter == 2);
+  CHECK(blackboard.pause == 1);
+  CHECK(fsm.size() == 2);
+
+  CHECK_FALSE(fsm.push_state(state_dummy{3}, blackboard));
+  CHECK(blackboard.enter == 2);
+  CHECK(blackboard.pause == 1);
+  CHECK(fsm.size() == 2);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 2);
+
+  fsm.pop_state(blackboard);
+  CHECK(blackboard.exit == 2);
+  CHECK(blackboard.resume == 1);
+
+  CHECK(fsm.push_state(state_dummy{3}, blackboard));
+  CHECK(blackboard.enter == 3);
+  CHECK(blackboard.pause == 1);
+
+  fsm.pop_state(blackboard);
+  fsm.pop_state(blackboard);
+  CHECK(blackboard.exit == 1);
+  CHECK(fsm.size() == 0);
+
+  fsm.pop_state(blackboard);
+  CHECK(fsm.size() == 0);
+}
+
+class state_other final : public state<blackboard_type> {
+  public:
+    virtual void enter(blackboard_type& blackboard) override {
+      blackboard.enter = -1;
+    }
+
+    virtual void exit(blackboard_type& blackboard) override {
+      blackboard.exit = -1;
+    }
+};
+
+TEST_CASE("fsm instrumentation") {
+  SUBCASE("simple machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = simple_machine<blackboard_type, machine_stats>{};
+
+    for (int i = 0; i < 3; i++) {
+      fsm.set_state(state_dummy{1}, blackboard);
+      fsm.update(blackboard);
+      fsm.update(blackboard);
+      fsm.clear_state(blackboard);
+    }
+
+    auto& stats = fsm.recorder();
+    CHECK(stats.transition_count<void, state_dummy>() == 3);
+    CHECK(stats.transition_count<state_dummy, void>() == 3);
+    CHECK(stats.transition_count<state_dummy, state_dummy>() == 0);
+
+    auto entry = stats.find<state_dummy>();
+    REQUIRE(entry != nullptr);
+    CHECK(entry->update_count == 6);
+    CHECK(entry->max_update_time <= entry->update_time);
+    CHECK(entry->time_in_state >= entry->update_time);
+
+    auto total = machine_stats{};
+    total.merge(stats);
+    total.merge(stats);
+    CHECK(total.transition_count<void, state_dummy>() == 6);
+    CHECK(total.find<state_dummy>()->update_count == 12);
+  }
+
+  SUBCASE("stack machine") {
+    auto blackboard = blackboard_type{};
+    auto heap_fsm = stack_machine<blackboard_type, 0, 64, machine_stats>{};
+    auto inline_fsm = stack_machine<blackboard_type, 4, 64, machine_stats>{};
+
+    auto run = [&](auto& fsm) {
+      fsm.push_state(state_dummy{1}, blackboard);
+      fsm.push_state(state_other{}, blackboard);
+      fsm.update(blackboard);
+      fsm.pop_state(blackboard);
+      fsm.update(blackboard);
+      fsm.pop_state(blackboard);
+
+      auto& stats = fsm.recorder();
+      CHECK(stats.template transition_count<void, state_dummy>() == 1);
+      CHECK(stats.template transition_count<state_dummy, state_other>() == 1);
+      CHECK(stats.template transition_count<state_other, state_dummy>() == 1);
+      CHECK(stats.template transition_count<state_dummy, void>() == 1);
+      CHECK(stats.template find<state_other>()->update_count == 1);
+      CHECK(stats.template find<state_dummy>()->update_count == 1);
+    };
+
+    run(heap_fsm);
+    run(inline_fsm);
+  }
+}
+
+class state_saved final : public state<blackboard_type> {
+  public:
+    state_saved() = default;
+    state_saved(std::uint64_t value) : m_val(value) {}
+
+    virtual void enter(blackboard_type& blackboard) override {
+      blackboard.enter++;
+    }
+
+    virtual void update(blackboard_type& blackboard) override {
+      blackboard.update = static_cast<int>(m_val);
+    }
+
+    void save(snapshot_writer& writer) const {
+      writer.write_varint(m_val);
+    }
+
+    bool load(snapshot_reader& reader) {
+      return reader.read_varint(m_val);
+    }
+
+  private:
+    std::uint64_t m_val{0};
+};
+
+TEST_CASE("fsm snapshot") {
+  auto registry = state_registry<blackboard_type>{};
+  CHECK(registry.add<state_other>() == 0);
+  CHECK(registry.add<state_saved>() == 1);
+  CHECK(registry.add<state_other>() == 0);
+  CHECK(registry.id_of<state_dummy>() == no_state);
+
+  SUBCASE("simple machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = simple_machine<blackboard_type>{};
+    auto writer = snapshot_writer{};
+
+    CHECK(fsm.save(writer, registry));
+
+    fsm.set_state(state_saved{300}, blackboard);
+    fsm.pause(blackboard);
+    CHECK(fsm.save(writer, registry));
+
+    fsm.set_state(state_dummy{1}, blackboard);
+    CHECK_FALSE(fsm.save(writer, registry));
+
+    // 1 byte for the empty machine, 1 for the header, 2 for the payload
+    auto buffer = writer.release();
+    CHECK(buffer.size() == 4);
+
+    auto reader = snapshot_reader{buffer};
+    auto restored = simple_machine<blackboard_type>{};
+    blackboard = blackboard_type{};
+
+    CHECK(restored.restore(reader, registry));
+    restored.update(blackboard);
+    CHECK(blackboard.update == 0);
+
+    CHECK(restored.restore(reader, registry));
+    CHECK(reader.remaining() == 0);
+    CHECK(blackboard.enter == 0);
+
+    restored.update(blackboard);
+    CHECK(blackboard.update == 0);
+
+    restored.resume(blackboard);
+    restored.update(blackboard);
+    CHECK(blackboard.update == 300);
+
+    CHECK_FALSE(restored.restore(reader, registry));
+    restored.update(blackboard);
+    CHECK(blackboard.update == 300);
+  }
+
+  SUBCASE("varints") {
+    auto writer = snapshot_writer{};
+    writer.write_varint(UINT64_MAX);
+
+    auto buffer = writer.release();
+    CHECK(buffer.size() == 10);
+
+    auto value = std::uint64_t{0};
+    auto reader = snapshot_reader{buffer};
+    CHECK(reader.read_varint(value));
+    CHECK(value == UINT64_MAX);
+
+    // the 10th byte only holds the 64th bit
+    buffer.back() = std::byte{0x02};
+    auto overflow_reader = snapshot_reader{buffer};
+    CHECK_FALSE(overflow_reader.read_varint(value));
+  }
+
+  SUBCASE("stack machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = stack_machine<blackboard_type>{};
+    auto writer = snapshot_writer{};
+
+    fsm.push_state(state_saved{1}, blackboard);
+    fsm.push_state(state_other{}, blackboard);
+    fsm.push_state(state_saved{2}, blackboard);
+    CHECK(fsm.save(writer, registry));
+
+    auto buffer = writer.release();
+    blackboard = blackboard_type{};
+
+    auto heap_reader = snapshot_reader{buffer};
+    auto heap_fsm = stack_machine<blackboard_type>{};
+    CHECK(heap_fsm.restore(heap_reader, registry));
+
+    auto inline_reader = snapshot_reader{buffer};
+    auto inline_fsm = stack_machine<blackboard_type, 4>{};
+    CHECK(inline_fsm.restore(inline_reader, registry));
+    CHECK(inline_fsm.size() == 3);
+    CHECK(blackboard.enter == 0);
+
+    heap_fsm.update(blackboard);
+    CHECK(blackboard.update == 2);
+    heap_fsm.pop_state(blackboard);
+    heap_fsm.pop_state(blackboard);
+    heap_fsm.update(blackboard);
+    CHECK(blackboard.update == 1);
+
+    inline_fsm.update(blackboard);
+    CHECK(blackboard.update == 2);
+
+    auto small_reader = snapshot_reader{buffer};
+    auto small_fsm = stack_machine<blackboard_type, 2>{};
+    CHECK_FALSE(small_fsm.restore(small_reader, registry));
+    CHECK(small_fsm.size() == 0);
+
+    auto truncated = std::span<const std::byte>{buffer}.first(buffer.size() - 1);
+    auto truncated_reader = snapshot_reader{truncated};
+    CHECK_FALSE(heap_fsm.restore(truncated_reader, registry));
+
+    // an invalid snapshot leaves the fixed-capacity stack untouched
+    auto inline_truncated_reader = snapshot_reader{truncated};
+    CHECK_FALSE(inline_fsm.restore(inline_truncated_reader, registry));
+    CHECK(inline_fsm.size() == 3);
+    blackboard.update = 0;
+    inline_fsm.update(blackboard);
+    CHECK(blackboard.update == 2);
+  }
+}
+
+TEST_CASE("fsm transition history") {
+  auto blackboard = blackboard_type{};
+  auto fsm = simple_machine<blackboard_type, transition_history<2>>{};
+
+  fsm.set_state(state_dummy{1}, blackboard);
+  fsm.update(blackboard);
+  fsm.update(blackboard);
+  fsm.set_state(state_other{}, blackboard);
+  fsm.update(blackboard);
+  fsm.clear_state(blackboard);
+
+  auto& history = fsm.recorder();
+  CHECK(history.total() == 3);
+  REQUIRE(history.size() == 2);
+
+  CHECK(history[0].tick == 2);
+  CHECK(history[0].from == std::type_index(typeid(state_dummy)));
+  CHECK(history[0].to == std::type_index(typeid(state_other)));
+
+  CHECK(history[1].tick == 3);
+  CHECK(history[1].from == std::type_index(typeid(state_other)));
+  CHECK(history[1].to == std::type_index(typeid(void)));
+}
+
+TEST_CASE("fsm static machine") {
+  auto blackboard = blackboard_type{};
+  auto fsm = static_machine<blackboard_type, state_dummy, state_other>{};
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.set_state(state_dummy{1}, blackboard);
+  CHECK(blackboard.enter == 1);
+
+  fsm.pause(blackboard);
+  CHECK(blackboard.pause == 1);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.resume(blackboard);
+  CHECK(blackboard.resume == 1);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 1);
+
+  fsm.set_state(state_other{}, blackboard);
+  CHECK(blackboard.exit == 1);
+  CHECK(blackboard.enter == -1);
+
+  fsm.clear_state(blackboard);
+  CHECK(blackboard.exit == -1);
+
+  fsm.pause(blackboard);
+  fsm.set_state(state_dummy{3}, blackboard);
+  CHECK(blackboard.enter == 3);
+  CHECK(blackboard.pause == 3);
+}
+
+class state_move_only final : public state<blackboard_type> {
+  public:
+    state_move_only(int value) : m_val(std::make_unique<int>(value)) {}
+
+    state_move_only(const state_move_only&) = delete;
+    state_move_only(state_move_only&&) = default;
+
+    virtual void enter(blackboard_type& blackboard) override {
+      blackboard.enter = *m_val;
+    }
+
+    virtual void update(blackboard_type& blackboard) override {
+      blackboard.update = *m_val;
+    }
+
+  private:
+    std::unique_ptr<int> m_val;
+};
+
+TEST_CASE("fsm emplace state") {
+  SUBCASE("simple machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = simple_machine<blackboard_type>{};
+
+    fsm.emplace_state<state_dummy>(blackboard, 1);
+    CHECK(blackboard.enter == 1);
+
+    fsm.set_state(state_move_only{2}, blackboard);
+    CHECK(blackboard.exit == 1);
+    CHECK(blackboard.enter == 2);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 2);
+  }
+
+  SUBCASE("stack machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = stack_machine<blackboard_type>{};
+
+    fsm.emplace_state<state_dummy>(blackboard, 1);
+    CHECK(blackboard.enter == 1);
+
+    fsm.emplace_state<state_move_only>(blackboard, 2);
+    CHECK(blackboard.pause == 1);
+    CHECK(blackboard.enter == 2);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 2);
+
+    fsm.pop_state(blackboard);
+    CHECK(blackboard.resume == 1);
+  }
+
+  SUBCASE("static machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = static_machine<blackboard_type, state_dummy, state_move_only>{};
+
+    fsm.emplace_state<state_move_only>(blackboard, 3);
+    CHECK(blackboard.enter == 3);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 3);
+  }
+}
+
+static stack_machine<blackboard_type>* deferred_stack = nullptr;
+
+class state_spawner final : public state<blackboard_type> {
+  public:
+    virtual void enter(blackboard_type& blackboard) override {
+      blackboard.enter = 10;
+      deferred_stack->push_state(state_dummy{7}, blackboard);
+    }
+};
+
+TEST_CASE("fsm deferred transitions") {
+  SUBCASE("simple machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = simple_machine<blackboard_type>{transition_mode::deferred};
+
+    fsm.set_state(state_dummy{1}, blackboard);
+    CHECK(fsm.has_pending());
+    CHECK(blackboard.enter == 0);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 0);
+
+    CHECK(fsm.commit(blackboard));
+    CHECK_FALSE(fsm.has_pending());
+    CHECK(blackboard.enter == 1);
+
+    fsm.set_state(state_dummy{2}, blackboard);
+    fsm.set_state(state_dummy{3}, blackboard);
+    CHECK(fsm.commit(blackboard));
+    CHECK(blackboard.exit == 1);
+    CHECK(blackboard.enter == 3);
+
+    fsm.clear_state(blackboard);
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 3);
+
+    CHECK(fsm.commit(blackboard));
+    CHECK(blackboard.exit == 3);
+    CHECK_FALSE(fsm.commit(blackboard));
+  }
+
+  SUBCASE("stack machine") {
+    auto blackboard = blackboard_type{};
+    auto fsm = stack_machine<blackboard_type>{transition_mode::deferred};
+
+    fsm.push_state(state_dummy{1}, blackboard);
+    fsm.push_state(state_dummy{2}, blackboard);
+    fsm.pop_state(blackboard);
+    CHECK(fsm.has_pending());
+    CHECK(blackboard.enter == 0);
+
+    CHECK(fsm.commit(blackboard) == 3);
+    CHECK_FALSE(fsm.has_pending());
+    CHECK(blackboard.enter == 2);
+    CHECK(blackboard.pause == 1);
+    CHECK(blackboard.exit == 2);
+    CHECK(blackboard.resume == 1);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 1);
+  }
+
+  SUBCASE("transitions requested while committing") {
+    auto blackboard = blackboard_type{};
+    auto fsm = stack_machine<blackboard_type>{transition_mode::deferred};
+    deferred_stack = &fsm;
+
+    fsm.push_state(state_spawner{}, blackboard);
+    fsm.push_state(state_spawner{}, blackboard);
+    fsm.push_state(state_spawner{}, blackboard);
+
+    // every spawner requests a child, applied by the next commit
+    CHECK(fsm.commit(blackboard) == 3);
+    CHECK(fsm.has_pending());
+    CHECK(blackboard.enter == 10);
+
+    CHECK(fsm.commit(blackboard) == 3);
+    CHECK_FALSE(fsm.has_pending());
+    CHECK(blackboard.enter == 7);
+
+    fsm.update(blackboard);
+    CHECK(blackboard.update == 7);
+  }
+}
+
+class state_counter final : public state<blackboard_type> {
+  public:
+    virtual void enter(blackboard_type& blackboard) override {
+      m_enter_count++;
+      blackboard.enter = 100 + m_enter_count;
+    }
+
+    virtual void exit(blackboard_type& blackboard) override {
+      blackboard.exit = 100 + m_enter_count;
+    }
+
+    virtual void update(blackboard_type& blackboard) override {
+      blackboard.update = 100 + m_enter_count;
+    }
+
+  private:
+    int m_enter_count{0};
+};
+
+TEST_CASE("fsm orthogonal machine") {
+  auto blackboard = blackboard_type{};
+  auto fsm = orthogonal_machine<blackboard_type, 3>{};
+
+  CHECK(fsm.set_state(0, state_dummy{1}, blackboard));
+  CHECK(fsm.emplace_state<state_counter>(2, blackboard));
+  CHECK_FALSE(fsm.set_state(3, state_dummy{2}, blackboard));
+  CHECK(blackboard.enter == 101);
+
+  CHECK(fsm.has_state(0));
+  CHECK_FALSE(fsm.has_state(1));
+  CHECK(fsm.has_state(2));
+
+  // regions are updated in order
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 101);
+
+  CHECK(fsm.set_state(2, state_dummy{3}, blackboard));
+  CHECK(blackboard.exit == 101);
+  CHECK(blackboard.enter == 3);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 3);
+
+  fsm.pause(blackboard);
+  CHECK(blackboard.pause == 3);
+  fsm.set_state(1, state_dummy{4}, blackboard);
+  CHECK(blackboard.pause == 4);
+
+  blackboard.update = 0;
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.resume(blackboard);
+  fsm.clear_state(2, blackboard);
+  CHECK(blackboard.exit == 3);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 4);
+
+  fsm.clear_state(blackboard);
+  CHECK(blackboard.exit == 4);
+  CHECK_FALSE(fsm.has_state(0));
+}
+
+TEST_CASE("fsm flyweight machine") {
+  auto blackboard = blackboard_type{};
+  auto other_blackboard = blackboard_type{};
+  auto fsm = flyweight_machine<blackboard_type>{};
+  auto other_fsm = flyweight_machine<blackboard_type>{};
+
+  CHECK(sizeof(fsm) <= 2 * sizeof(void*));
+
+  fsm.set_state<state_other>(blackboard);
+  other_fsm.set_state<state_other>(other_blackboard);
+  CHECK(blackboard.enter == -1);
+  CHECK(fsm.is_in_state<state_other>());
+  CHECK_FALSE(fsm.is_in_state<state_counter>());
+
+  auto shared = state_dummy{5};
+  fsm.set_state(shared, blackboard);
+  other_fsm.set_state(shared, other_blackboard);
+  CHECK(blackboard.exit == -1);
+  CHECK(blackboard.enter == 5);
+  CHECK(fsm.is_in_state<state_dummy>());
+
+  fsm.pause(blackboard);
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.resume(blackboard);
+  fsm.update(blackboard);
+  other_fsm.update(other_blackboard);
+  CHECK(blackboard.update == 5);
+  CHECK(other_blackboard.update == 5);
+
+  fsm.clear_state(blackboard);
+  CHECK(blackboard.exit == 5);
+  CHECK_FALSE(fsm.is_in_state<state_dummy>());
+}
+
+struct door_blackboard {
+  int enters{0};
+  int exits{0};
+  int angle{0};
+};
+
+struct door_traits {
+  enum class state { closed, opening, open, closing };
+
+  static constexpr std::size_t state_count = 4;
+
+  static constexpr auto transitions = std::array{
+    enum_transition{state::closed, state::opening},
+    enum_transition{state::opening, state::open},
+    enum_transition{state::open, state::closing},
+    enum_transition{state::closing, state::closed},
+    enum_transition{state::closing, state::opening},
+  };
+
+  static void enter(auto, door_blackboard& door) {
+    door.enters++;
+  }
+
+  static void exit(state_tag<state::opening>, door_blackboard& door) {
+    door.exits++;
+  }
+
+  static void update(state_tag<state::opening>, door_blackboard& door) {
+    door.angle += 10;
+  }
+
+  static void update(state_tag<state::closing>, door_blackboard& door) {
+    door.angle -= 10;
+  }
+};
+
+TEST_CASE("fsm enum machine") {
+  using door_state = door_traits::state;
+  using door_machine = enum_machine<door_blackboard, door_traits>;
+
+  static_assert(door_machine::has_transition<door_state::closed, door_state::opening>());
+  static_assert(!door_machine::has_transition<door_state::closed, door_state::open>());
+  static_assert(door_machine::is_reachable<door_state::open>());
+
+  auto door = door_blackboard{};
+  auto fsm = door_machine{};
+
+  CHECK_FALSE(fsm.has_state());
+  CHECK_FALSE(fsm.transition_to<door_state::opening>(door));
+
+  fsm.set_state<door_state::closed>(door);
+  CHECK(fsm.current_state() == door_state::closed);
+  CHECK(door.enters == 1);
+
+  fsm.update(door);
+  CHECK(door.angle == 0);
+
+  CHECK_FALSE(fsm.can_transition_to(door_state::open));
+  CHECK_FALSE(fsm.transition_to<door_state::open>(door));
+  CHECK(fsm.current_state() == door_state::closed);
+
+  CHECK(fsm.transition_to<door_state::opening>(door));
+  CHECK(door.enters == 2);
+
+  fsm.update(door);
+  fsm.update(door);
+  CHECK(door.angle == 20);
+
+  CHECK(fsm.transition_to<door_state::open>(door));
+  CHECK(door.exits == 1);
+
+  CHECK(fsm.transition_to<door_state::closing>(door));
+  fsm.update(door);
+  CHECK(door.angle == 10);
+
+  fsm.clear_state(door);
+  CHECK_FALSE(fsm.has_state());
+}
+
+TEST_CASE("fsm indexed machine") {
+  using machine_type = indexed_machine<blackboard_type, state_dummy, state_counter>;
+
+  auto blackboard = blackboard_type{};
+  auto fsm = machine_type{state_dummy{1}, state_counter{}};
+
+  CHECK(machine_type::id_of<state_dummy>() == 0);
+  CHECK(machine_type::id_of<state_counter>() == 1);
+  CHECK(fsm.current_state() == no_state);
+
+  CHECK(fsm.transition_to(0, blackboard));
+  CHECK(fsm.current_state() == 0);
+  CHECK(blackboard.enter == 1);
+
+  fsm.transition_to<state_counter>(blackboard);
+  CHECK(blackboard.exit == 1);
+  CHECK(blackboard.enter == 101);
+
+  fsm.pause(blackboard);
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.resume(blackboard);
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 101);
+
+  fsm.transition_to<state_dummy>(blackboard);
+  fsm.transition_to<state_counter>(blackboard);
+  CHECK(blackboard.enter == 102);
+
+  CHECK_FALSE(fsm.transition_to(2, blackboard));
+  CHECK(fsm.current_state() == 1);
+
+  fsm.clear_state(blackboard);
+  CHECK(blackboard.exit == 102);
+  CHECK(fsm.current_state() == no_state);
+}
+
+TEST_CASE("fsm event machine") {
+  enum class door_state { closed, open, locked, count };
+  enum class door_event { push, pull, lock, unlock, count };
+
+  auto blackboard = blackboard_type{};
+  auto fsm = event_machine<blackboard_type, door_state, door_event>(
+    door_state::count,
+    door_event::count,
+    {
+      {door_state::closed, door_event::push, door_state::open},
+      {door_state::open, door_event::pull, door_state::closed},
+      {door_state::closed, door_event::lock, door_state::locked, [](blackboard_type& blackboard) {
+        blackboard.update++;
+      }},
+      {door_state::locked, door_event::unlock, door_state::closed},
+      {door_state::locked, door_event::count, door_state::open}
+    },
+    door_state::closed
+  );
+
+  CHECK(fsm.current_state() == door_state::closed);
+
+  CHECK(fsm.dispatch(door_event::push, blackboard));
+  CHECK(fsm.current_state() == door_state::open);
+
+  CHECK_FALSE(fsm.dispatch(door_event::lock, blackboard));
+  CHECK(fsm.current_state() == door_state::open);
+
+  CHECK(fsm.dispatch(door_event::pull, blackboard));
+  CHECK(fsm.dispatch(door_event::lock, blackboard));
+  CHECK(fsm.current_state() == door_state::locked);
+  CHECK(blackboard.update == 1);
+
+  CHECK_FALSE(fsm.dispatch(door_event::count, blackboard));
+  CHECK(fsm.dispatch(door_event::unlock, blackboard));
+  CHECK(fsm.current_state() == door_state::closed);
+}
+
+struct trace_blackboard {
+  std::string trace;
+};
+
+class state_trace final : public state<trace_blackboard> {
+  public:
+    state_trace(char name) : m_name(name) {}
+
+    virtual void enter(trace_blackboard& blackboard) override {
+      blackboard.trace += '+';
+      blackboard.trace += m_name;
+    }
+
+    virtual void exit(trace_blackboard& blackboard) override {
+      blackboard.trace += '-';
+      blackboard.trace += m_name;
+    }
+
+    virtual void update(trace_blackboard& blackboard) override {
+      blackboard.trace += m_name;
+    }
+
+  private:
+    char m_name;
+};
+
+TEST_CASE("fsm hierarchical machine") {
+  auto blackboard = trace_blackboard{};
+  auto fsm = hierarchical_machine<trace_blackboard>{};
+
+  auto alive = fsm.add_state(state_trace{'A'});
+  auto idle = fsm.add_state(state_trace{'I'}, alive);
+  auto combat = fsm.add_state(state_trace{'C'}, alive);
+  auto attack = fsm.add_state(state_trace{'K'}, combat);
+  auto dodge = fsm.add_state(state_trace{'D'}, combat);
+  auto dead = fsm.add_state(state_trace{'X'});
+
+  CHECK(fsm.add_state(state_trace{'?'}, 42) == no_state);
+  CHECK(fsm.set_initial_state(alive, idle));
+  CHECK(fsm.set_initial_state(combat, attack));
+  CHECK_FALSE(fsm.set_initial_state(alive, attack));
+  CHECK_FALSE(fsm.set_initial_state(no_state, alive));
+  fsm.build();
+
+  CHECK(fsm.transition_to(alive, blackboard));
+  CHECK(blackboard.trace == "+A+I");
+  CHECK(fsm.current_state() == idle);
+
+  blackboard.trace.clear();
+  fsm.transition_to(combat, blackboard);
+  CHECK(blackboard.trace == "-I+C+K");
+  CHECK(fsm.current_state() == attack);
+  CHECK(fsm.is_in_state(alive));
+  CHECK(fsm.is_in_state(combat));
+  CHECK_FALSE(fsm.is_in_state(idle));
+
+  blackboard.trace.clear();
+  fsm.update(blackboard);
+  CHECK(blackboard.trace == "ACK");
+
+  blackboard.trace.clear();
+  fsm.transition_to(dodge, blackboard);
+  CHECK(blackboard.trace == "-K+D");
+
+  blackboard.trace.clear();
+  fsm.transition_to(dodge, blackboard);
+  CHECK(blackboard.trace == "-D+D");
+
+  blackboard.trace.clear();
+  fsm.transition_to(combat, blackboard);
+  CHECK(blackboard.trace == "-D-C+C+K");
+
+  blackboard.trace.clear();
+  fsm.transition_to(dead, blackboard);
+  CHECK(blackboard.trace == "-K-C-A+X");
+
+  CHECK_FALSE(fsm.transition_to(42, blackboard));
+
+  blackboard.trace.clear();
+  fsm.clear_state(blackboard);
+  CHECK(blackboard.trace == "-X");
+  CHECK(fsm.current_state() == no_state);
+}
+
+TEST_CASE("fsm machine pool") {
+  using pool_type = machine_pool<blackboard_type, state_dummy, state_move_only>;
+
+  auto pool = pool_type{};
+  auto a = pool.add_machine(blackboard_type{});
+  auto b = pool.add_machine(blackboard_type{});
+  auto c = pool.add_machine(blackboard_type{});
+
+  CHECK(pool.size() == 3);
+  CHECK(pool.current_state(a) == no_state);
+
+  pool.set_state(a, state_dummy{1});
+  pool.set_state(b, state_dummy{2});
+  pool.emplace_state<state_move_only>(c, 3);
+
+  CHECK(pool.blackboard(a).enter == 1);
+  CHECK(pool.blackboard(b).enter == 2);
+  CHECK(pool.blackboard(c).enter == 3);
+  CHECK(pool.count<state_dummy>() == 2);
+  CHECK(pool.count<state_move_only>() == 1);
+
+  pool.update();
+  CHECK(pool.blackboard(a).update == 1);
+  CHECK(pool.blackboard(b).update == 2);
+  CHECK(pool.blackboard(c).update == 3);
+
+  pool.emplace_state<state_move_only>(a, 4);
+  CHECK(pool.blackboard(a).exit == 1);
+  CHECK(pool.current_state(a) == pool_type::id_of<state_move_only>());
+  CHECK(pool.count<state_dummy>() == 1);
+  CHECK(pool.count<state_move_only>() == 2);
+
+  pool.update();
+  CHECK(pool.blackboard(a).update == 4);
+  CHECK(pool.blackboard(b).update == 2);
+
+  pool.remove_machine(b);
+  CHECK(pool.blackboard(b).exit == 2);
+  CHECK_FALSE(pool.contains(b));
+  CHECK(pool.size() == 2);
+  CHECK(pool.count<state_dummy>() == 0);
+
+  // the slot is reused with a new identifier, stale requests are ignored
+  auto d = pool.add_machine(blackboard_type{});
+  CHECK(d != b);
+  CHECK(pool.contains(d));
+  CHECK_FALSE(pool.contains(b));
+  CHECK(pool.current_state(d) == no_state);
+
+  pool.set_state(b, state_dummy{5});
+  CHECK(pool.current_state(d) == no_state);
+  CHECK(pool.blackboard(d).enter == 0);
+}
+
+TEST_CASE("fsm machine pool groups") {
+  auto pool = machine_pool<blackboard_type, state_dummy>{};
+
+  auto outside = pool.add_machine(blackboard_type{});
+  auto first = pool.add_machine(blackboard_type{}, 2);
+  auto second = pool.add_machine(blackboard_type{}, 2);
+
+  CHECK(pool.group_of(outside) == 0);
+  CHECK(pool.group_of(first) == 2);
+
+  pool.set_state(outside, state_dummy{1});
+  pool.set_state(first, state_dummy{2});
+  pool.set_state(second, state_dummy{3});
+
+  pool.pause_group(2);
+  CHECK(pool.is_group_paused(2));
+  CHECK_FALSE(pool.is_group_paused(0));
+
+  // the states are paused when first accessed
+  pool.update();
+  pool.update();
+  CHECK(pool.blackboard(outside).update == 1);
+  CHECK(pool.blackboard(first).update == 0);
+  CHECK(pool.blackboard(first).pause == 2);
+  CHECK(pool.blackboard(second).pause == 3);
+
+  // entering a state in a paused group pauses it
+  pool.set_state(second, state_dummy{4});
+  CHECK(pool.blackboard(second).exit == 3);
+  CHECK(pool.blackboard(second).pause == 4);
+
+  pool.resume_group(2);
+  pool.update();
+  CHECK(pool.blackboard(first).resume == 2);
+  CHECK(pool.blackboard(first).update == 2);
+  CHECK(pool.blackboard(second).resume == 4);
+  CHECK(pool.blackboard(second).update == 4);
+
+  // pausing then resuming before any access calls nothing
+  pool.pause_group(2);
+  pool.resume_group(2);
+  pool.set_state(first, state_dummy{6});
+  pool.update();
+  CHECK(pool.blackboard(first).pause == 2);
+  CHECK(pool.blackboard(first).update == 6);
+
+  // a transition pauses the state before exiting it
+  pool.pause_group(2);
+  pool.clear_state(first);
+  CHECK(pool.blackboard(first).pause == 6);
+  CHECK(pool.blackboard(first).exit == 6);
+
+  pool.resume_group(2);
+  pool.set_state(first, state_dummy{2});
+  pool.blackboard(first) = blackboard_type{};
+
+  pool.clear_group(2);
+  CHECK(pool.current_state(first) == no_state);
+  CHECK(pool.current_state(outside) == 0);
+  CHECK(pool.blackboard(first).exit == 0);
+
+  pool.update();
+  CHECK(pool.blackboard(first).exit == 2);
+  CHECK(pool.blackboard(second).exit == 4);
+  CHECK(pool.count<state_dummy>() == 1);
+
+  pool.pause_group(2);
+  pool.clear_group(2);
+  pool.set_state(first, state_dummy{5});
+  CHECK(pool.blackboard(first).enter == 5);
+  CHECK(pool.blackboard(first).pause == 5);
+  CHECK(pool.current_state(first) == 0);
+}
+
+TEST_CASE("fsm machine pool group partitions") {
+  using pool_type = machine_pool<blackboard_type, state_dummy>;
+  auto pool = pool_type{};
+
+  CHECK(pool.add_machine(blackboard_type{}, pool_type::max_group_count) == no_machine);
+
+  // interleave the groups, so that every insertion moves states around
+  auto ids = std::vector<machine_id>{};
+  for (int idx = 0; idx < 24; idx++) {
+    auto id = pool.add_machine(blackboard_type{}, static_cast<group_id>(idx % 4));
+    pool.set_state(id, state_dummy{idx + 1});
+    ids.push_back(id);
+  }
+
+  for (int idx = 0; idx < 24; idx += 5) {
+    pool.clear_state(ids[idx]);
+  }
+
+  pool.pause_group(1);
+  pool.update();
+
+  for (int idx = 0; idx < 24; idx++) {
+    auto& blackboard = pool.blackboard(ids[idx]);
+    auto cleared = idx % 5 == 0;
+
+    if (cleared) {
+      CHECK(blackboard.exit == idx + 1);
+      CHECK(blackboard.update == 0);
+    }
+    else if (idx % 4 == 1) {
+      CHECK(blackboard.pause == idx + 1);
+      CHECK(blackboard.update == 0);
+    }
+    else {
+      CHECK(blackboard.update == idx + 1);
+    }
+  }
+
+  CHECK(pool.count<state_dummy>() == 19);
+}
+
+struct pooled_blackboard {
+  machine_id id;
+  int pings{0};
+  int pongs{0};
+};
+
+class state_ping final : public state<pooled_blackboard> {
+  public:
+    virtual void update(pooled_blackboard& blackboard) override;
+};
+
+class state_pong final : public state<pooled_blackboard> {
+  public:
+    virtual void update(pooled_blackboard& blackboard) override {
+      blackboard.pongs++;
+    }
+};
+
+using transition_pool = machine_pool<pooled_blackboard, state_ping, state_pong>;
+
+static transition_pool* current_pool = nullptr;
+
+void state_ping::update(pooled_blackboard& blackboard) {
+  blackboard.pings++;
+  current_pool->set_state(blackboard.id, state_pong{});
+}
+
+TEST_CASE("fsm machine pool transitions during update") {
+  auto pool = transition_pool{};
+  current_pool = &pool;
+
+  for (machine_id i = 0; i < 4; i++) {
+    auto id = pool.add_machine(pooled_blackboard{.id = i});
+    pool.set_state(id, state_ping{});
+  }
+
+  pool.update();
+  CHECK(pool.count<state_ping>() == 0);
+  CHECK(pool.count<state_pong>() == 4);
+
+  for (machine_id i = 0; i < 4; i++) {
+    CHECK(pool.blackboard(i).pings == 1);
+    CHECK(pool.blackboard(i).pongs == 0);
+  }
+
+  pool.update();
+  for (machine_id i = 0; i < 4; i++) {
+    CHECK(pool.blackboard(i).pongs == 1);
+  }
+}
+
+class state_retire final : public state<pooled_blackboard> {
+  public:
+    virtual void exit(pooled_blackboard& blackboard) override {
+      blackboard.pongs++;
+    }
+
+    virtual void update(pooled_blackboard& blackboard) override;
+};
+
+using retiring_pool = machine_pool<pooled_blackboard, state_retire, state_pong>;
+
+static retiring_pool* current_retiring_pool = nullptr;
+
+void state_retire::update(pooled_blackboard& blackboard) {
+  blackboard.pings++;
+  current_retiring_pool->remove_machine(blackboard.id);
+}
+
+TEST_CASE("fsm machine pool removal during update") {
+  auto pool = retiring_pool{};
+  current_retiring_pool = &pool;
+
+  auto first = pool.add_machine(pooled_blackboard{.id = 0});
+  auto second = pool.add_machine(pooled_blackboard{.id = 1});
+  pool.set_state(first, state_retire{});
+  pool.set_state(second, state_retire{});
+
+  pool.update();
+  CHECK(pool.size() == 0);
+  CHECK(pool.count<state_retire>() == 0);
+  CHECK(pool.blackboard(first).pings == 1);
+  CHECK(pool.blackboard(first).pongs == 1);
+  CHECK(pool.blackboard(second).pongs == 1);
+
+  // a reused identifier does not inherit the state of the removed machine
+  auto reused = pool.add_machine(pooled_blackboard{.id = 0});
+  CHECK(pool.current_state(reused) == no_state);
+
+  pool.update();
+  CHECK(pool.blackboard(reused).pings == 0);
+}
+
+struct alarm_raised {
+  int level;
+};
+
+struct all_clear {};
+
+class state_sleep final : public state<pooled_blackboard> {};
+
+class state_guard final : public state<pooled_blackboard> {
+  public:
+    void on_event(const alarm_raised& event, pooled_blackboard& blackboard);
+};
+
+using routing_pool = machine_pool<pooled_blackboard, state_sleep, state_guard>;
+
+static routing_pool* current_routing_pool = nullptr;
+
+void state_guard::on_event(const alarm_raised& event, pooled_blackboard& blackboard) {
+  blackboard.pings += event.level;
+  current_routing_pool->set_state(blackboard.id, state_sleep{});
+}
+
+TEST_CASE("fsm machine pool event routing") {
+  auto pool = routing_pool{};
+  current_routing_pool = &pool;
+
+  for (machine_id i = 0; i < 6; i++) {
+    auto id = pool.add_machine(pooled_blackboard{.id = i});
+
+    if (i % 3 == 0) {
+      pool.set_state(id, state_guard{});
+    }
+    else {
+      pool.set_state(id, state_sleep{});
+    }
+  }
+
+  CHECK(pool.subscriber_count<alarm_raised>() == 2);
+  CHECK(pool.subscriber_count<all_clear>() == 0);
+  CHECK(pool.broadcast(all_clear{}) == 0);
+
+  CHECK(pool.broadcast(alarm_raised{2}) == 2);
+  CHECK(pool.blackboard(0).pings == 2);
+  CHECK(pool.blackboard(1).pings == 0);
+  CHECK(pool.blackboard(3).pings == 2);
+
+  // the guards went to sleep once the event was delivered
+  CHECK(pool.subscriber_count<alarm_raised>() == 0);
+  CHECK(pool.broadcast(alarm_raised{2}) == 0);
+
+  pool.set_state(4, state_guard{});
+  CHECK_FALSE(pool.send(0, alarm_raised{1}));
+  CHECK(pool.send(4, alarm_raised{1}));
+  CHECK(pool.blackboard(4).pings == 1);
+  CHECK(pool.count<state_guard>() == 0);
+}
+
+TEST_CASE("fsm machine pool history") {
+  auto pool = transition_pool{};
+  current_pool = &pool;
+  pool.enable_history(4);
+
+  auto first = pool.add_machine(pooled_blackboard{.id = 0});
+  auto second = pool.add_machine(pooled_blackboard{.id = 1});
+
+  pool.set_state(first, state_ping{});
+  pool.update();
+  pool.update();
+  pool.clear_state(first);
+
+  auto entries = std::vector<transition_pool::history_entry>{};
+  pool.history(first, [&](const auto& entry) {
+    entries.push_back(entry);
+  });
+
+  REQUIRE(entries.size() == 3);
+  CHECK(entries[0].tick == 0);
+  CHECK(entries[0].from == no_state);
+  CHECK(entries[0].to == transition_pool::id_of<state_ping>());
+  CHECK(entries[1].tick == 0);
+  CHECK(entries[1].to == transition_pool::id_of<state_pong>());
+  CHECK(entries[2].tick == 2);
+  CHECK(entries[2].to == no_state);
+
+  for (int i = 0; i < 3; i++) {
+    pool.set_state(second, state_pong{});
+  }
+
+  auto dumped = std::vector<machine_id>{};
+  pool.dump_history([&](machine_id id, const auto&) {
+    dumped.push_back(id);
+  });
+
+  CHECK(dumped == std::vector<machine_id>{first, first, first, second, second, second});
+}
+
+TEST_CASE("fsm event queue") {
+  SUBCASE("events are popped in order until the queue is empty") {
+    auto queue = event_queue<int>(3);
+    CHECK(queue.capacity() == 4);
+
+    for (int i = 0; i < 4; i++) {
+      CHECK(queue.try_push(i));
+    }
+    CHECK_FALSE(queue.try_push(4));
+
+    auto event = queue.try_pop();
+    REQUIRE(event.has_value());
+    CHECK(*event == 0);
+    CHECK(queue.try_push(4));
+
+    auto events = std::vector<int>{};
+    CHECK(queue.drain([&](int e) { events.push_back(e); }) == 4);
+    CHECK(events == std::vector<int>{1, 2, 3, 4});
+    CHECK_FALSE(queue.try_pop().has_value());
+  }
+
+  SUBCASE("events can be pushed from many threads") {
+    constexpr int producer_count = 4;
+    constexpr int events_per_producer = 10000;
+
+    auto queue = event_queue<int>(256);
+    auto producers = std::vector<std::thread>{};
+
+    for (int p = 0; p < producer_count; p++) {
+      producers.emplace_back([&queue]() {
+        for (int i = 1; i <= events_per_producer; i++) {
+          while (!queue.try_push(i)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+
+    long long sum = 0;
+    int count = 0;
+    while (count < producer_count * events_per_producer) {
+      count += static_cast<int>(queue.drain([&](int e) { sum += e; }));
+    }
+
+    for (auto& producer : producers) {
+      producer.join();
+    }
+
+    CHECK(sum == producer_count * (events_per_producer * (events_per_producer + 1LL) / 2));
+  }
+
+  SUBCASE("event machine dispatches queued events") {
+    auto blackboard = blackboard_type{};
+    auto queue = event_queue<event_id>(8);
+    auto fsm = event_machine<blackboard_type>(
+      2,
+      1,
+      {
+        {0, 0, 1},
+        {1, 0, 0}
+      },
+      0
+    );
+
+    queue.try_push(0);
+    queue.try_push(0);
+    queue.try_push(0);
+
+    CHECK(fsm.dispatch_queued(queue, blackboard) == 3);
+    CHECK(fsm.current_state() == 1);
+  }
+
+  SUBCASE("machine pool applies queued transitions before updating") {
+    using pool_type = machine_pool<blackboard_type, state_dummy, state_move_only>;
+
+    auto pool = pool_type{};
+    auto requests = event_queue<pool_type::transition_request>(8);
+    auto a = pool.add_machine(blackboard_type{});
+    auto b = pool.add_machine(blackboard_type{});
+
+    pool.set_state(b, state_dummy{1});
+
+    auto producer = std::thread([&]() {
+      requests.try_push({a, state_dummy{2}});
+      requests.try_push({b, std::monostate{}});
+    });
+    producer.join();
+
+    pool.update(requests);
+    CHECK(pool.blackboard(a).enter == 2);
+    CHECK(pool.blackboard(a).update == 2);
+    CHECK(pool.blackboard(b).exit == 1);
+    CHECK(pool.current_state(b) == no_state);
+  }
+}
+
+class state_sleeper final : public state<blackboard_type> {
+  public:
+    state_sleeper(tick_type period) : m_period(period) {}
+
+    virtual void update(blackboard_type& blackboard) override {
+      blackboard.update++;
+    }
+
+    tick_type next_update(blackboard_type& blackboard, tick_type now) {
+      return m_period == 0 ? wake_on_event : now + m_period;
+    }
+
+  private:
+    tick_type m_period;
+};
+
+TEST_CASE("fsm machine scheduler") {
+  auto scheduler = machine_scheduler<blackboard_type>{};
+
+  auto every_tick = scheduler.add_machine(blackboard_type{});
+  auto every_ten = scheduler.add_machine(blackboard_type{});
+  auto far_away = scheduler.add_machine(blackboard_type{});
+  auto on_event = scheduler.add_machine(blackboard_type{});
+
+  scheduler.set_state(every_tick, state_sleeper{1});
+  scheduler.set_state(every_ten, state_sleeper{10});
+  scheduler.set_state(far_away, state_sleeper{100'000});
+  scheduler.set_state(on_event, state_sleeper{0});
+
+  CHECK(scheduler.wake_tick(every_tick) == 1);
+  CHECK(scheduler.wake_tick(on_event) == wake_on_event);
+
+  for (int i = 0; i < 1000; i++) {
+    scheduler.update();
+  }
+
+  CHECK(scheduler.now() == 1000);
+  CHECK(scheduler.blackboard(every_tick).update == 999);
+  CHECK(scheduler.blackboard(every_ten).update == 99);
+  CHECK(scheduler.blackboard(far_away).update == 0);
+  CHECK(scheduler.blackboard(on_event).update == 0);
+
+  scheduler.wake(on_event);
+  CHECK(scheduler.update() == 3);
+  CHECK(scheduler.blackboard(on_event).update == 1);
+  CHECK(scheduler.wake_tick(on_event) == wake_on_event);
+
+  while (scheduler.now() <= 100'000) {
+    scheduler.update();
+  }
+
+  CHECK(scheduler.blackboard(far_away).update == 1);
+  CHECK(scheduler.wake_tick(far_away) == 200'000);
+  CHECK(scheduler.blackboard(every_ten).update == 10'000);
+
+  scheduler.remove_machine(every_tick);
+  CHECK_FALSE(scheduler.contains(every_tick));
+  CHECK(scheduler.size() == 3);
+
+  auto update_count = scheduler.blackboard(every_ten).update;
+  scheduler.machine(every_ten).pause(scheduler.blackboard(every_ten));
+  for (int i = 0; i < 20; i++) {
+    scheduler.update();
+  }
+  CHECK(scheduler.blackboard(every_ten).update <= update_count + 1);
+  CHECK(scheduler.wake_tick(every_ten) == wake_on_event);
+
+  // a state without next_update is updated at every tick
+  static_assert(scheduled_state<state_sleeper, blackboard_type>);
+  static_assert(!scheduled_state<state_dummy, blackboard_type>);
+
+  scheduler.machine(on_event).set_state(state_dummy{1}, scheduler.blackboard(on_event));
+  scheduler.wake(on_event);
+  scheduler.update();
+  CHECK(scheduler.blackboard(on_event).update == 1);
+  CHECK(scheduler.wake_tick(on_event) == scheduler.now());
+}
+
+class state_phases final : public coroutine_state<blackboard_type> {
+  public:
+    virtual state_task run(blackboard_type& blackboard) override {
+      blackboard.update = 1;
+      co_await next_tick{};
+
+      blackboard.update = 2;
+      co_await wait_ticks{3};
+
+      blackboard.update = 3;
+      co_await wait_until{[&]() { return blackboard.pause > 0; }};
+
+      blackboard.update = 4;
+      co_await wait_event{42};
+
+      blackboard.update = 5;
+    }
+};
+
+static_assert(!std::move_constructible<state_phases>);
+
+TEST_CASE("fsm coroutine state") {
+  auto blackboard = blackboard_type{};
+  auto fsm = simple_machine<blackboard_type>{};
+
+  fsm.emplace_state<state_phases>(blackboard);
+  CHECK(blackboard.update == 0);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 1);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 2);
+
+  fsm.update(blackboard);
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 2);
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 3);
+
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 3);
+  blackboard.pause = 1;
+  fsm.update(blackboard);
+  CHECK(blackboard.update == 4);
+
+  auto phases = state_phases{};
+  phases.enter(blackboard);
+  phases.update(blackboard);
+  CHECK(blackboard.update == 1);
+  phases.exit(blackboard);
+  CHECK(phases.done());
+
+  blackboard.pause = 0;
+  phases.enter(blackboard);
+  for (int i = 0; i < 6; i++) {
+    phases.update(blackboard);
+  }
+  CHECK(blackboard.update == 3);
+
+  blackboard.pause = 1;
+  phases.update(blackboard);
+  phases.notify(7);
+  CHECK(blackboard.update == 4);
+
+  phases.notify(42);
+  CHECK(blackboard.update == 5);
+  CHECK(phases.done());
+
+  fsm.clear_state(blackboard);
+}
+
+TEST_CASE("fsm coroutine frame pool") {
+  auto first = detail::frame_pool::allocate(100);
+  detail::frame_pool::deallocate(first, 100);
+
+  auto second = detail::frame_pool::allocate(120);
+  CHECK(second == first);
+  detail::frame_pool::deallocate(second, 120);
+
+  auto large = detail::frame_pool::allocate(4096);
+  CHECK(large != nullptr);
+  detail::frame_pool::deallocate(large, 4096);
+}